@@ -0,0 +1,54 @@
+#include "asset_pack.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+// Usage: asset-pack [--lz4|--zstd] <output.pack> <data-directory> <asset>...
+// Assets are named by their path relative to the data directory, e.g. "gl-320/texture-2d.vert",
+// which is the name the samples use to resolve them.
+int main(int argc, char* argv[])
+{
+	int Arg = 1;
+	pack::codec Codec = pack::CODEC_NONE;
+	if(Arg < argc && std::strcmp(argv[Arg], "--lz4") == 0)
+		Codec = pack::CODEC_LZ4, ++Arg;
+	else if(Arg < argc && std::strcmp(argv[Arg], "--zstd") == 0)
+		Codec = pack::CODEC_ZSTD, ++Arg;
+
+	if(argc - Arg < 3)
+	{
+		std::fprintf(stderr, "Usage: %s [--lz4|--zstd] <output.pack> <data-directory> <asset>...\n", argv[0]);
+		return 1;
+	}
+
+	std::string const Output(argv[Arg++]);
+	std::string const Directory(argv[Arg++]);
+
+	pack::writer Writer(Codec);
+	for(; Arg < argc; ++Arg)
+	{
+		std::ifstream File((Directory + "/" + argv[Arg]).c_str(), std::ios::binary);
+		if(!File)
+		{
+			std::fprintf(stderr, "Can't open %s/%s\n", Directory.c_str(), argv[Arg]);
+			return 1;
+		}
+
+		std::vector<char> Data((std::istreambuf_iterator<char>(File)), std::istreambuf_iterator<char>());
+		if(!Writer.add(argv[Arg], Data))
+		{
+			std::fprintf(stderr, "Can't compress %s, codec not built in\n", argv[Arg]);
+			return 1;
+		}
+	}
+
+	if(!Writer.save(Output))
+	{
+		std::fprintf(stderr, "Can't write %s, duplicate asset name or I/O error\n", Output.c_str());
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,96 @@
+#include "batch.hpp"
+#include "options.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// Usage: batch-runner [--list] [--filter <text>] [--repeat <n>] [--batch-output <file>]
+//                     [--program-cache <dir>] [sample options]...
+// Runs every sample linked in, built with GLF_BATCH, one after the other in this process. The
+// other options are handed to each sample unchanged. Program binaries and CPU side blobs stay
+// cached from one sample to the next, with --program-cache binaries also persist across runs.
+// The timing of each run goes to stdout, or to --batch-output as CSV when the name ends in .csv
+// and JSON otherwise.
+namespace
+{
+	bool hasSuffix(std::string const& String, char const* Suffix)
+	{
+		std::size_t const Length = std::strlen(Suffix);
+		return String.size() >= Length && String.compare(String.size() - Length, Length, Suffix) == 0;
+	}
+
+	struct result
+	{
+		char const* Name;
+		std::size_t Run;
+		double Milliseconds;
+		int Error;
+	};
+}//namespace
+
+int main(int argc, char* argv[])
+{
+	std::vector<batch::unit> const& Units = batch::units();
+
+	if(options::find(argc, argv, "--list"))
+	{
+		for(std::size_t i = 0; i < Units.size(); ++i)
+			std::printf("%s\n", Units[i].Name);
+		return 0;
+	}
+
+	char const* const Filter = options::find(argc, argv, "--filter");
+	char const* const Output = options::find(argc, argv, "--batch-output");
+	std::size_t const RunCount = std::max<std::size_t>(1, options::count(argc, argv, "--repeat", 1));
+
+	batch::configure(argc, argv);
+
+	std::vector<result> Results;
+	int Error = 0;
+	for(std::size_t Run = 0; Run < RunCount; ++Run)
+		for(std::size_t i = 0; i < Units.size(); ++i)
+		{
+			if(Filter && *Filter && !std::strstr(Units[i].Name, Filter))
+				continue;
+
+			std::chrono::steady_clock::time_point const Start = std::chrono::steady_clock::now();
+			int const UnitError = Units[i].Main(argc, argv);
+			double const Milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - Start).count();
+
+			result const Result = {Units[i].Name, Run, Milliseconds, UnitError};
+			Results.push_back(Result);
+			Error += UnitError;
+
+			std::fprintf(stderr, "%s: %.1f ms%s\n", Units[i].Name, Milliseconds, UnitError ? ", failed" : "");
+		}
+
+	std::string const Filename(Output ? Output : "");
+	FILE* File = Filename.empty() ? stdout : std::fopen(Filename.c_str(), "w");
+	if(!File)
+		return 1;
+
+	if(hasSuffix(Filename, ".csv"))
+	{
+		std::fprintf(File, "sample,run,ms,pass\n");
+		for(std::size_t i = 0; i < Results.size(); ++i)
+			std::fprintf(File, "%s,%u,%.3f,%d\n", Results[i].Name, unsigned(Results[i].Run), Results[i].Milliseconds, Results[i].Error == 0 ? 1 : 0);
+	}
+	else
+	{
+		std::fprintf(File, "[\n");
+		for(std::size_t i = 0; i < Results.size(); ++i)
+			std::fprintf(File, "\t{\"sample\": \"%s\", \"run\": %u, \"ms\": %.3f, \"pass\": %s}%s\n",
+				Results[i].Name, unsigned(Results[i].Run), Results[i].Milliseconds, Results[i].Error == 0 ? "true" : "false", i + 1 < Results.size() ? "," : "");
+		std::fprintf(File, "]\n");
+	}
+
+	if(File != stdout)
+		std::fclose(File);
+
+	return Error;
+}
@@ -0,0 +1,14 @@
+#version 150 core
+
+// Depth only pass: position and transform, no material and no varyings
+uniform transform
+{
+	mat4 MVP;
+} Transform;
+
+in vec2 Position;
+
+void main()
+{
+	gl_Position = Transform.MVP * vec4(Position, 0.0, 1.0);
+}
@@ -0,0 +1,24 @@
+#version 150 core
+
+// Depth only vertex pulling: only the position is fetched, Layout.z is ignored.
+uniform samplerBuffer Vertices;
+uniform ivec4 Layout;
+
+uniform transform
+{
+	mat4 MVP;
+} Transform;
+
+float fetch(int Index)
+{
+	return texelFetch(Vertices, Index).r;
+}
+
+void main()
+{
+	int Base = gl_VertexID * Layout.x;
+
+	vec2 Position = vec2(fetch(Base + Layout.y), fetch(Base + Layout.y + 1));
+
+	gl_Position = Transform.MVP * vec4(Position, 0.0, 1.0);
+}
@@ -0,0 +1,42 @@
+#version 150 core
+
+// Vertex pulling: vertices are fetched from a buffer texture instead of vertex attributes.
+// Layout is described by the application in floats: x stride, y position offset, z texcoord offset or -1.
+uniform samplerBuffer Vertices;
+uniform ivec4 Layout;
+
+#define MAX_INSTANCES 64
+
+uniform transform
+{
+	mat4 MVP;
+} Transform;
+
+uniform material
+{
+	ivec4 Layer[MAX_INSTANCES];
+	vec4 Offset[MAX_INSTANCES];
+} Material;
+
+out block
+{
+	vec2 Texcoord;
+	flat int Layer;
+} Out;
+
+float fetch(int Index)
+{
+	return texelFetch(Vertices, Index).r;
+}
+
+void main()
+{
+	// gl_VertexID includes the base vertex of glDrawElements*BaseVertex
+	int Base = gl_VertexID * Layout.x;
+
+	vec2 Position = vec2(fetch(Base + Layout.y), fetch(Base + Layout.y + 1));
+	Out.Texcoord = Layout.z < 0 ? vec2(0.0) : vec2(fetch(Base + Layout.z), fetch(Base + Layout.z + 1));
+	Out.Layer = Material.Layer[gl_InstanceID].x;
+
+	gl_Position = Transform.MVP * vec4(Position + Material.Offset[gl_InstanceID].xy, 0.0, 1.0);
+}
@@ -0,0 +1,32 @@
+#version 150 core
+
+// fbo-depth-multisample.frag for dynamic resolution, only used with --dynamic-resolution: the
+// depth pass covers the bottom left of the target and may use fewer samples than allocated
+uniform sampler2DMS Diffuse;
+
+// Render size over window size
+uniform vec2 Scale;
+uniform int Samples;
+
+// Near and far planes of the depth pass projection, x near, y far
+uniform vec2 Planes;
+
+out vec4 Color;
+
+float linearize(float Depth)
+{
+	float Near = Planes.x;
+	float Far = Planes.y;
+	return (2.0 * Near) / (Far + Near - (Depth * 2.0 - 1.0) * (Far - Near));
+}
+
+void main()
+{
+	ivec2 Texel = ivec2(gl_FragCoord.xy * Scale);
+
+	float Depth = 0.0;
+	for(int i = 0; i < Samples; ++i)
+		Depth += texelFetch(Diffuse, Texel, i).r;
+
+	Color = vec4(vec3(linearize(Depth / float(Samples))), 1.0);
+}
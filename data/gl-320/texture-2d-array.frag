@@ -0,0 +1,16 @@
+#version 150 core
+
+uniform sampler2DArray Diffuse;
+
+in block
+{
+	vec2 Texcoord;
+	flat int Layer;
+} In;
+
+out vec4 Color;
+
+void main()
+{
+	Color = texture(Diffuse, vec3(In.Texcoord, float(In.Layer)));
+}
@@ -0,0 +1,32 @@
+#version 150 core
+
+#define MAX_INSTANCES 64
+
+uniform transform
+{
+	mat4 MVP;
+} Transform;
+
+// Atlas layer of each instance, x only, ivec4 keeps the std140 array stride explicit.
+// Offset moves the instance in model space, xy only
+uniform material
+{
+	ivec4 Layer[MAX_INSTANCES];
+	vec4 Offset[MAX_INSTANCES];
+} Material;
+
+in vec2 Position;
+in vec2 Texcoord;
+
+out block
+{
+	vec2 Texcoord;
+	flat int Layer;
+} Out;
+
+void main()
+{
+	Out.Texcoord = Texcoord;
+	Out.Layer = Material.Layer[gl_InstanceID].x;
+	gl_Position = Transform.MVP * vec4(Position + Material.Offset[gl_InstanceID].xy, 0.0, 1.0);
+}
@@ -0,0 +1,366 @@
+#include "asset_pack.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <fstream>
+#include <set>
+#include <thread>
+
+#if !defined(_WIN32)
+#	include <fcntl.h>
+#	include <sys/mman.h>
+#	include <sys/stat.h>
+#	include <unistd.h>
+#endif
+
+#if defined(GLF_ASSET_PACK_LZ4)
+#	include <lz4.h>
+#endif
+#if defined(GLF_ASSET_PACK_ZSTD)
+#	include <zstd.h>
+#endif
+
+namespace pack
+{
+	unsigned long long hash(char const* Name, std::size_t Length)
+	{
+		unsigned long long Hash = 14695981039346656037ull;
+		for(std::size_t i = 0; i < Length; ++i)
+		{
+			Hash ^= static_cast<unsigned char>(Name[i]);
+			Hash *= 1099511628211ull;
+		}
+		return Hash;
+	}
+
+	bool compress(codec Codec, std::vector<char> const& Source, std::vector<char>& Destination)
+	{
+		switch(Codec)
+		{
+		default:
+			return false;
+		case CODEC_NONE:
+			Destination = Source;
+			return true;
+#		if defined(GLF_ASSET_PACK_LZ4)
+		case CODEC_LZ4:
+		{
+			Destination.resize(LZ4_compressBound(int(Source.size())));
+			int const Size = LZ4_compress_default(Source.data(), Destination.data(), int(Source.size()), int(Destination.size()));
+			Destination.resize(std::size_t(std::max(Size, 0)));
+			return Size > 0;
+		}
+#		endif
+#		if defined(GLF_ASSET_PACK_ZSTD)
+		case CODEC_ZSTD:
+		{
+			Destination.resize(ZSTD_compressBound(Source.size()));
+			std::size_t const Size = ZSTD_compress(Destination.data(), Destination.size(), Source.data(), Source.size(), 19);
+			if(ZSTD_isError(Size))
+				return false;
+			Destination.resize(Size);
+			return true;
+		}
+#		endif
+		}
+	}
+
+	bool decompress(codec Codec, char const* Source, std::size_t SourceSize, char* Destination, std::size_t DestinationSize)
+	{
+		switch(Codec)
+		{
+		default:
+			return false;
+		case CODEC_NONE:
+			if(SourceSize != DestinationSize)
+				return false;
+			std::memcpy(Destination, Source, SourceSize);
+			return true;
+#		if defined(GLF_ASSET_PACK_LZ4)
+		case CODEC_LZ4:
+			return LZ4_decompress_safe(Source, Destination, int(SourceSize), int(DestinationSize)) == int(DestinationSize);
+#		endif
+#		if defined(GLF_ASSET_PACK_ZSTD)
+		case CODEC_ZSTD:
+			return ZSTD_decompress(Destination, DestinationSize, Source, SourceSize) == DestinationSize;
+#		endif
+		}
+	}
+
+	writer::writer(codec Codec) :
+		Codec(Codec)
+	{}
+
+	bool writer::add(std::string const& Name, std::vector<char> const& Data)
+	{
+		item Item;
+		Item.Name = Name;
+		Item.Size = Data.size();
+		Item.Codec = Codec;
+
+		if(!compress(Codec, Data, Item.Data))
+			return false;
+
+		// Not worth paying the decompression for assets that don't shrink
+		if(Item.Data.size() >= Data.size())
+		{
+			Item.Data = Data;
+			Item.Codec = CODEC_NONE;
+		}
+
+		this->Items.push_back(Item);
+		return true;
+	}
+
+	bool writer::save(std::string const& Filename) const
+	{
+		std::set<std::string> Names;
+		for(std::size_t i = 0; i < this->Items.size(); ++i)
+			if(!Names.insert(this->Items[i].Name).second)
+				return false;
+
+		std::ofstream File(Filename.c_str(), std::ios::binary);
+		if(!File)
+			return false;
+
+		std::size_t BucketCount = 1;
+		while(BucketCount < this->Items.size() * 2)
+			BucketCount <<= 1;
+
+		header Header;
+		std::memcpy(Header.Magic, MAGIC, sizeof(MAGIC));
+		Header.Version = 1;
+		Header.EntryCount = static_cast<unsigned int>(this->Items.size());
+		Header.BucketCount = static_cast<unsigned int>(BucketCount);
+		Header.PageSize = static_cast<unsigned int>(BLOB_ALIGNMENT);
+		Header.IndexOffset = 0;
+
+		std::vector<entry> Entries(this->Items.size());
+		std::vector<unsigned int> Buckets(BucketCount, 0);
+		std::string NameTable;
+
+		std::vector<char> const Padding(BLOB_ALIGNMENT, 0);
+		unsigned long long Offset = BLOB_ALIGNMENT;
+		File.write(reinterpret_cast<char const*>(&Header), sizeof(Header));
+		File.write(&Padding[0], BLOB_ALIGNMENT - sizeof(Header));
+
+		for(std::size_t i = 0; i < this->Items.size(); ++i)
+		{
+			item const& Item = this->Items[i];
+
+			entry& Entry = Entries[i];
+			Entry.Hash = hash(Item.Name.c_str(), Item.Name.size());
+			Entry.Offset = Offset;
+			Entry.StoredSize = Item.Data.size();
+			Entry.Size = Item.Size;
+			Entry.NameOffset = static_cast<unsigned int>(NameTable.size());
+			Entry.Codec = Item.Codec;
+			NameTable.append(Item.Name.c_str(), Item.Name.size() + 1);
+
+			std::size_t Bucket = std::size_t(Entry.Hash) & (BucketCount - 1);
+			while(Buckets[Bucket] != 0)
+				Bucket = (Bucket + 1) & (BucketCount - 1);
+			Buckets[Bucket] = static_cast<unsigned int>(i + 1);
+
+			if(!Item.Data.empty())
+				File.write(&Item.Data[0], std::streamsize(Item.Data.size()));
+			std::size_t const Pad = (BLOB_ALIGNMENT - Item.Data.size() % BLOB_ALIGNMENT) % BLOB_ALIGNMENT;
+			File.write(&Padding[0], std::streamsize(Pad));
+			Offset += Item.Data.size() + Pad;
+		}
+
+		Header.IndexOffset = Offset;
+		if(!Entries.empty())
+			File.write(reinterpret_cast<char const*>(&Entries[0]), std::streamsize(Entries.size() * sizeof(entry)));
+		File.write(reinterpret_cast<char const*>(&Buckets[0]), std::streamsize(Buckets.size() * sizeof(unsigned int)));
+		File.write(NameTable.data(), std::streamsize(NameTable.size()));
+
+		File.seekp(0);
+		File.write(reinterpret_cast<char const*>(&Header), sizeof(Header));
+
+		return !File.fail();
+	}
+
+	reader::reader(std::string const& Filename) :
+		Memory(nullptr),
+		MemorySize(0)
+	{
+#		if defined(_WIN32)
+			this->Mapping = nullptr;
+			this->File = CreateFileA(Filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_RANDOM_ACCESS, nullptr);
+			if(this->File == INVALID_HANDLE_VALUE)
+				return;
+
+			LARGE_INTEGER Size;
+			if(!GetFileSizeEx(this->File, &Size))
+				return;
+
+			this->Mapping = CreateFileMappingA(this->File, nullptr, PAGE_READONLY, 0, 0, nullptr);
+			if(this->Mapping == nullptr)
+				return;
+
+			this->Memory = static_cast<char const*>(MapViewOfFile(this->Mapping, FILE_MAP_READ, 0, 0, 0));
+			this->MemorySize = this->Memory ? std::size_t(Size.QuadPart) : 0;
+#		else
+			this->File = open(Filename.c_str(), O_RDONLY);
+			if(this->File < 0)
+				return;
+
+			struct stat Stat;
+			if(fstat(this->File, &Stat) != 0)
+				return;
+
+			void* Pointer = mmap(nullptr, std::size_t(Stat.st_size), PROT_READ, MAP_PRIVATE, this->File, 0);
+			if(Pointer == MAP_FAILED)
+				return;
+
+			this->Memory = static_cast<char const*>(Pointer);
+			this->MemorySize = std::size_t(Stat.st_size);
+#		endif
+
+		// Every size is checked against what is left of the file so a corrupted header can't overflow
+		header const* Header = reinterpret_cast<header const*>(this->Memory);
+		bool const Valid =
+			this->MemorySize >= sizeof(header) &&
+			std::memcmp(Header->Magic, MAGIC, sizeof(MAGIC)) == 0 &&
+			Header->Version == 1 &&
+			Header->IndexOffset <= this->MemorySize &&
+			Header->EntryCount <= (this->MemorySize - Header->IndexOffset) / sizeof(entry) &&
+			Header->BucketCount <= (this->MemorySize - Header->IndexOffset - Header->EntryCount * sizeof(entry)) / sizeof(unsigned int) &&
+			Header->BucketCount != 0 && (Header->BucketCount & (Header->BucketCount - 1)) == 0;
+
+		if(!Valid)
+		{
+#			if defined(_WIN32)
+				UnmapViewOfFile(this->Memory);
+#			else
+				munmap(const_cast<char*>(this->Memory), this->MemorySize);
+#			endif
+			this->Memory = nullptr;
+			this->MemorySize = 0;
+		}
+	}
+
+	reader::~reader()
+	{
+#		if defined(_WIN32)
+			if(this->Memory)
+				UnmapViewOfFile(this->Memory);
+			if(this->Mapping)
+				CloseHandle(this->Mapping);
+			if(this->File != INVALID_HANDLE_VALUE)
+				CloseHandle(this->File);
+#		else
+			if(this->Memory)
+				munmap(const_cast<char*>(this->Memory), this->MemorySize);
+			if(this->File >= 0)
+				close(this->File);
+#		endif
+	}
+
+	bool reader::empty() const
+	{
+		return this->Memory == nullptr;
+	}
+
+	char const* reader::name(entry const& Entry) const
+	{
+		header const* Header = reinterpret_cast<header const*>(this->Memory);
+		std::size_t const NameTable = std::size_t(Header->IndexOffset) + Header->EntryCount * sizeof(entry) + Header->BucketCount * sizeof(unsigned int);
+		std::size_t const NameTableSize = this->MemorySize - NameTable;
+		if(Entry.NameOffset >= NameTableSize)
+			return nullptr;
+
+		char const* Name = this->Memory + NameTable + Entry.NameOffset;
+		return std::memchr(Name, '\0', NameTableSize - Entry.NameOffset) ? Name : nullptr;
+	}
+
+	entry const* reader::lookup(std::string const& Name) const
+	{
+		if(this->empty())
+			return nullptr;
+
+		header const* Header = reinterpret_cast<header const*>(this->Memory);
+		entry const* Entries = reinterpret_cast<entry const*>(this->Memory + Header->IndexOffset);
+		unsigned int const* Buckets = reinterpret_cast<unsigned int const*>(Entries + Header->EntryCount);
+
+		unsigned long long const Hash = hash(Name.c_str(), Name.size());
+		std::size_t const Mask = Header->BucketCount - 1;
+		for(std::size_t Bucket = std::size_t(Hash) & Mask, Probe = 0; Probe < Header->BucketCount; Bucket = (Bucket + 1) & Mask, ++Probe)
+		{
+			if(Buckets[Bucket] == 0 || Buckets[Bucket] > Header->EntryCount)
+				return nullptr;
+
+			entry const& Entry = Entries[Buckets[Bucket] - 1];
+			if(Entry.Hash != Hash)
+				continue;
+
+			char const* EntryName = this->name(Entry);
+			if(!EntryName || Name != EntryName)
+				continue;
+
+			bool const Inside = Entry.Offset <= this->MemorySize && Entry.StoredSize <= this->MemorySize - Entry.Offset;
+			bool const Stored = Entry.Codec != CODEC_NONE || Entry.StoredSize == Entry.Size;
+			return Inside && Stored ? &Entry : nullptr;
+		}
+
+		return nullptr;
+	}
+
+	bool reader::find(std::string const& Name, void const*& Data, std::size_t& Size) const
+	{
+		entry const* Entry = this->lookup(Name);
+		if(!Entry || Entry->Codec != CODEC_NONE)
+			return false;
+
+		Data = this->Memory + Entry->Offset;
+		Size = std::size_t(Entry->Size);
+		return true;
+	}
+
+	bool reader::load(std::string const& Name, std::vector<char>& Data) const
+	{
+		entry const* Entry = this->lookup(Name);
+		if(!Entry)
+			return false;
+
+		Data.resize(std::size_t(Entry->Size));
+		return decompress(codec(Entry->Codec), this->Memory + Entry->Offset, std::size_t(Entry->StoredSize), Data.data(), Data.size());
+	}
+
+	bool reader::digest(std::string const& Name, unsigned long long& Hash) const
+	{
+		entry const* Entry = this->lookup(Name);
+		if(!Entry)
+			return false;
+
+		Hash = hash(this->Memory + Entry->Offset, std::size_t(Entry->StoredSize)) ^ Entry->Codec;
+		return true;
+	}
+
+	bool reader::load(std::vector<std::string> const& Names, std::vector<std::vector<char> >& Data) const
+	{
+		Data.resize(Names.size());
+
+		std::atomic<std::size_t> Next(0);
+		std::atomic<bool> Validated(true);
+
+		auto Task = [&]()
+		{
+			for(std::size_t i = Next++; i < Names.size(); i = Next++)
+				if(!this->load(Names[i], Data[i]))
+					Validated = false;
+		};
+
+		std::size_t const ThreadCount = std::min<std::size_t>(Names.size(), std::max(1u, std::thread::hardware_concurrency()));
+		std::vector<std::thread> Threads;
+		for(std::size_t i = 1; i < ThreadCount; ++i)
+			Threads.push_back(std::thread(Task));
+		Task();
+		for(std::size_t i = 0; i < Threads.size(); ++i)
+			Threads[i].join();
+
+		return Validated;
+	}
+}//namespace pack
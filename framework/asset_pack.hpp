@@ -0,0 +1,118 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#if defined(_WIN32)
+#	ifndef NOMINMAX
+#		define NOMINMAX
+#	endif
+#	include <windows.h>
+#endif
+
+// Single file asset pack: a header, page aligned blobs and an index at the end of the file.
+// Lookups hash the asset name into an open addressing table stored in the file, so finding
+// an asset is O(1) and doesn't touch anything but the mapped index.
+namespace pack
+{
+	enum codec
+	{
+		CODEC_NONE,
+		CODEC_LZ4,
+		CODEC_ZSTD
+	};
+
+	// Blobs start on a page boundary so a mapped asset can be handed to GL as is
+	std::size_t const BLOB_ALIGNMENT = 4096;
+	char const MAGIC[8] = {'O', 'G', 'L', 'P', 'A', 'C', 'K', '1'};
+
+	struct header
+	{
+		char Magic[8];
+		unsigned int Version;
+		unsigned int EntryCount;
+		unsigned int BucketCount;
+		unsigned int PageSize;
+		unsigned long long IndexOffset;
+	};
+
+	struct entry
+	{
+		unsigned long long Hash;
+		unsigned long long Offset;
+		unsigned long long StoredSize;
+		unsigned long long Size;
+		unsigned int NameOffset;
+		unsigned int Codec;
+	};
+
+	// Index layout at header::IndexOffset:
+	// entry[EntryCount], unsigned int Bucket[BucketCount] holding entry index + 1, then the names.
+	unsigned long long hash(char const* Name, std::size_t Length);
+
+	bool compress(codec Codec, std::vector<char> const& Source, std::vector<char>& Destination);
+	bool decompress(codec Codec, char const* Source, std::size_t SourceSize, char* Destination, std::size_t DestinationSize);
+
+	class writer
+	{
+	public:
+		explicit writer(codec Codec = CODEC_NONE);
+
+		bool add(std::string const& Name, std::vector<char> const& Data);
+
+		// Fails without creating the file when two assets have the same name
+		bool save(std::string const& Filename) const;
+
+	private:
+		struct item
+		{
+			std::string Name;
+			std::vector<char> Data;
+			std::size_t Size;
+			codec Codec;
+		};
+
+		codec Codec;
+		std::vector<item> Items;
+	};
+
+	class reader
+	{
+	public:
+		explicit reader(std::string const& Filename);
+		~reader();
+
+		bool empty() const;
+
+		// Raw access to the mapped bytes of an uncompressed asset, no copy
+		bool find(std::string const& Name, void const*& Data, std::size_t& Size) const;
+
+		bool load(std::string const& Name, std::vector<char>& Data) const;
+
+		// Hash of the stored bytes of an asset, compressed or not, taken from the mapping without
+		// decompressing. Changes whenever the asset does, meant for cache keys
+		bool digest(std::string const& Name, unsigned long long& Hash) const;
+
+		// Decompress several assets at once, one task per asset spread over the hardware threads
+		bool load(std::vector<std::string> const& Names, std::vector<std::vector<char> >& Data) const;
+
+	private:
+		reader(reader const&);
+		reader& operator=(reader const&);
+
+		entry const* lookup(std::string const& Name) const;
+
+		// Name of an entry, null when the offset or the terminator falls outside the string table
+		char const* name(entry const& Entry) const;
+
+		char const* Memory;
+		std::size_t MemorySize;
+#		if defined(_WIN32)
+			HANDLE File;
+			HANDLE Mapping;
+#		else
+			int File;
+#		endif
+	};
+}//namespace pack
@@ -0,0 +1,362 @@
+#include "batch.hpp"
+#include "options.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <map>
+#include <sys/stat.h>
+
+namespace
+{
+	struct cache
+	{
+		cache() :
+			Running(false),
+			ProgramBinary(false)
+		{}
+
+		bool Running;
+		bool ProgramBinary;
+		std::string Directory;
+		std::map<std::string, std::pair<GLenum, std::vector<char> > > Programs;
+		std::map<std::string, std::vector<unsigned char> > Blobs;
+	};
+
+	// Function local statics, registration runs from other static initializers
+	cache& shared()
+	{
+		static cache Cache;
+		return Cache;
+	}
+
+	std::vector<batch::unit>& registry()
+	{
+		static std::vector<batch::unit> Units;
+		return Units;
+	}
+
+	// glProgramBinary raises GL_INVALID_ENUM for a format the driver doesn't list
+	bool supportedFormat(GLenum Format)
+	{
+		GLint FormatCount(0);
+		glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &FormatCount);
+		if(FormatCount <= 0)
+			return false;
+
+		std::vector<GLint> Formats(std::size_t(FormatCount), 0);
+		glGetIntegerv(GL_PROGRAM_BINARY_FORMATS, &Formats[0]);
+		return std::find(Formats.begin(), Formats.end(), GLint(Format)) != Formats.end();
+	}
+
+	// A binary is only valid for the driver that produced it
+	std::string filename(std::string const& Key)
+	{
+		std::string Identity = Key;
+		Identity += reinterpret_cast<char const*>(glGetString(GL_RENDERER));
+		Identity += reinterpret_cast<char const*>(glGetString(GL_VERSION));
+
+		char Name[32];
+		std::sprintf(Name, "%016llx.bin", pack::hash(Identity.c_str(), Identity.size()));
+		return shared().Directory + "/" + Name;
+	}
+
+	// Quiet state is what every sample leaves bound at the end of render(): it is reset without
+	// being reported, only the rest is worth a line on stderr
+	struct binding
+	{
+		GLenum Query;
+		GLint Default;
+		char const* Name;
+		bool Quiet;
+	};
+
+	struct capability
+	{
+		GLenum Cap;
+		char const* Name;
+	};
+
+	binding const Bindings[] =
+	{
+		{GL_CURRENT_PROGRAM, 0, "GL_CURRENT_PROGRAM", true},
+		{GL_VERTEX_ARRAY_BINDING, 0, "GL_VERTEX_ARRAY_BINDING", true},
+		{GL_ARRAY_BUFFER_BINDING, 0, "GL_ARRAY_BUFFER_BINDING", false},
+		{GL_UNIFORM_BUFFER_BINDING, 0, "GL_UNIFORM_BUFFER_BINDING", true},
+		{GL_COPY_READ_BUFFER_BINDING, 0, "GL_COPY_READ_BUFFER_BINDING", false},
+		{GL_COPY_WRITE_BUFFER_BINDING, 0, "GL_COPY_WRITE_BUFFER_BINDING", false},
+		{GL_PIXEL_PACK_BUFFER_BINDING, 0, "GL_PIXEL_PACK_BUFFER_BINDING", false},
+		{GL_PIXEL_UNPACK_BUFFER_BINDING, 0, "GL_PIXEL_UNPACK_BUFFER_BINDING", false},
+		{GL_DRAW_FRAMEBUFFER_BINDING, 0, "GL_DRAW_FRAMEBUFFER_BINDING", false},
+		{GL_READ_FRAMEBUFFER_BINDING, 0, "GL_READ_FRAMEBUFFER_BINDING", false},
+		{GL_RENDERBUFFER_BINDING, 0, "GL_RENDERBUFFER_BINDING", false},
+		{GL_ACTIVE_TEXTURE, GL_TEXTURE0, "GL_ACTIVE_TEXTURE", true},
+		{GL_DEPTH_FUNC, GL_LESS, "GL_DEPTH_FUNC", false},
+		{GL_UNPACK_ALIGNMENT, 4, "GL_UNPACK_ALIGNMENT", false},
+		{GL_PACK_ALIGNMENT, 4, "GL_PACK_ALIGNMENT", false}
+	};
+
+	capability const Capabilities[] =
+	{
+		{GL_DEPTH_TEST, "GL_DEPTH_TEST"},
+		{GL_BLEND, "GL_BLEND"},
+		{GL_CULL_FACE, "GL_CULL_FACE"},
+		{GL_SCISSOR_TEST, "GL_SCISSOR_TEST"},
+		{GL_STENCIL_TEST, "GL_STENCIL_TEST"},
+		{GL_MULTISAMPLE, "GL_MULTISAMPLE"},
+		{GL_SAMPLE_ALPHA_TO_COVERAGE, "GL_SAMPLE_ALPHA_TO_COVERAGE"},
+		{GL_RASTERIZER_DISCARD, "GL_RASTERIZER_DISCARD"},
+		{GL_PRIMITIVE_RESTART, "GL_PRIMITIVE_RESTART"}
+	};
+
+	// GL_MULTISAMPLE is the only capability enabled by default
+	GLboolean defaultCapability(GLenum Cap)
+	{
+		return Cap == GL_MULTISAMPLE ? GL_TRUE : GL_FALSE;
+	}
+
+	struct texture_target
+	{
+		GLenum Target;
+		GLenum Binding;
+	};
+
+	texture_target const TextureTargets[] =
+	{
+		{GL_TEXTURE_2D, GL_TEXTURE_BINDING_2D},
+		{GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BINDING_2D_ARRAY},
+		{GL_TEXTURE_2D_MULTISAMPLE, GL_TEXTURE_BINDING_2D_MULTISAMPLE},
+		{GL_TEXTURE_BUFFER, GL_TEXTURE_BINDING_BUFFER},
+		{GL_TEXTURE_3D, GL_TEXTURE_BINDING_3D},
+		{GL_TEXTURE_CUBE_MAP, GL_TEXTURE_BINDING_CUBE_MAP}
+	};
+
+	// Number of state values different from the defaults, each one that isn't quiet is printed
+	// when Title isn't null. Texture and indexed uniform buffer bindings are quiet
+	std::size_t check(char const* Title)
+	{
+		std::size_t Dirty(0);
+
+		for(std::size_t i = 0; i < sizeof(Bindings) / sizeof(Bindings[0]); ++i)
+		{
+			GLint Value(0);
+			glGetIntegerv(Bindings[i].Query, &Value);
+			if(Value == Bindings[i].Default)
+				continue;
+			if(Title && !Bindings[i].Quiet)
+				std::fprintf(stderr, "%s: %s is 0x%x\n", Title, Bindings[i].Name, Value);
+			++Dirty;
+		}
+
+		for(std::size_t i = 0; i < sizeof(Capabilities) / sizeof(Capabilities[0]); ++i)
+		{
+			if(glIsEnabled(Capabilities[i].Cap) == defaultCapability(Capabilities[i].Cap))
+				continue;
+			if(Title)
+				std::fprintf(stderr, "%s: %s is %s\n", Title, Capabilities[i].Name, defaultCapability(Capabilities[i].Cap) ? "disabled" : "enabled");
+			++Dirty;
+		}
+
+		GLint ActiveTexture(GL_TEXTURE0);
+		glGetIntegerv(GL_ACTIVE_TEXTURE, &ActiveTexture);
+		GLint TextureUnits(0);
+		glGetIntegerv(GL_MAX_COMBINED_TEXTURE_IMAGE_UNITS, &TextureUnits);
+		for(GLint Unit = 0; Unit < TextureUnits; ++Unit)
+		{
+			glActiveTexture(GLenum(GL_TEXTURE0 + Unit));
+			for(std::size_t i = 0; i < sizeof(TextureTargets) / sizeof(TextureTargets[0]); ++i)
+			{
+				GLint Value(0);
+				glGetIntegerv(TextureTargets[i].Binding, &Value);
+				if(Value != 0)
+					++Dirty;
+			}
+		}
+		glActiveTexture(GLenum(ActiveTexture));
+
+		GLint UniformBindings(0);
+		glGetIntegerv(GL_MAX_UNIFORM_BUFFER_BINDINGS, &UniformBindings);
+		for(GLint Index = 0; Index < UniformBindings; ++Index)
+		{
+			GLint Value(0);
+			glGetIntegeri_v(GL_UNIFORM_BUFFER_BINDING, GLuint(Index), &Value);
+			if(Value != 0)
+				++Dirty;
+		}
+
+		return Dirty;
+	}
+}//namespace
+
+namespace batch
+{
+	bool add(char const* Name, main_function Main)
+	{
+		unit const Unit = {Name, Main};
+		registry().push_back(Unit);
+		return true;
+	}
+
+	std::vector<unit> const& units()
+	{
+		return registry();
+	}
+
+	void configure(int argc, char* argv[])
+	{
+		shared().Running = true;
+		if(char const* Directory = options::find(argc, argv, "--program-cache"))
+			shared().Directory = Directory;
+	}
+
+	void setProgramBinary(bool Supported)
+	{
+		shared().ProgramBinary = Supported;
+	}
+
+	std::string programKey(pack::reader const& Pack, char const* Title, char const* const* Sources, std::size_t Count)
+	{
+		std::string Key(Title);
+		for(std::size_t i = 0; i < Count; ++i)
+		{
+			if(!Sources[i])
+				continue;
+
+			// Loose files are identified by size and modification time, no file is opened
+			unsigned long long Hash(0);
+			if(!Pack.digest(Sources[i], Hash))
+			{
+				struct stat Stat;
+				if(stat((getDataDirectory() + Sources[i]).c_str(), &Stat) == 0)
+					Hash = (static_cast<unsigned long long>(Stat.st_size) << 40) ^ static_cast<unsigned long long>(Stat.st_mtime);
+			}
+
+			char Digest[32];
+			std::sprintf(Digest, ":%016llx", Hash);
+			Key += ";";
+			Key += Sources[i];
+			Key += Digest;
+		}
+		return Key;
+	}
+
+	bool loadProgram(GLuint ProgramName, std::string const& Key)
+	{
+		if(!shared().ProgramBinary)
+			return false;
+
+		cache& Cache = shared();
+		std::map<std::string, std::pair<GLenum, std::vector<char> > >::iterator it = Cache.Programs.find(Key);
+		if(it == Cache.Programs.end() && !Cache.Directory.empty())
+		{
+			if(FILE* File = std::fopen(filename(Key).c_str(), "rb"))
+			{
+				GLenum Format(0);
+				std::vector<char> Binary;
+				if(std::fread(&Format, sizeof(Format), 1, File) == 1)
+				{
+					char Buffer[4096];
+					for(std::size_t Read = 0; (Read = std::fread(Buffer, 1, sizeof(Buffer), File)) > 0;)
+						Binary.insert(Binary.end(), Buffer, Buffer + Read);
+				}
+				std::fclose(File);
+
+				if(!Binary.empty())
+					it = Cache.Programs.insert(std::make_pair(Key, std::make_pair(Format, Binary))).first;
+			}
+		}
+
+		// A driver update invalidates binaries or drops their format, fall back to compiling. A
+		// rejected binary of a listed format only fails the link, it doesn't raise an error
+		if(it != Cache.Programs.end() && supportedFormat(it->second.first))
+		{
+			glProgramBinary(ProgramName, it->second.first, &it->second.second[0], GLsizei(it->second.second.size()));
+
+			GLint Status(GL_FALSE);
+			glGetProgramiv(ProgramName, GL_LINK_STATUS, &Status);
+			if(Status == GL_TRUE)
+				return true;
+		}
+		if(it != Cache.Programs.end())
+			Cache.Programs.erase(it);
+
+		glProgramParameteri(ProgramName, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+		return false;
+	}
+
+	void storeProgram(GLuint ProgramName, std::string const& Key)
+	{
+		if(!shared().ProgramBinary)
+			return;
+
+		cache& Cache = shared();
+		if(Cache.Programs.find(Key) != Cache.Programs.end())
+			return;
+
+		GLint Length(0);
+		glGetProgramiv(ProgramName, GL_PROGRAM_BINARY_LENGTH, &Length);
+		if(Length <= 0)
+			return;
+
+		GLenum Format(0);
+		std::vector<char> Binary(std::size_t(Length), 0);
+		glGetProgramBinary(ProgramName, Length, NULL, &Format, &Binary[0]);
+
+		if(!Cache.Directory.empty())
+			if(FILE* File = std::fopen(filename(Key).c_str(), "wb"))
+			{
+				std::fwrite(&Format, sizeof(Format), 1, File);
+				std::fwrite(&Binary[0], 1, Binary.size(), File);
+				std::fclose(File);
+			}
+
+		Cache.Programs.insert(std::make_pair(Key, std::make_pair(Format, Binary)));
+	}
+
+	std::vector<unsigned char>& blob(std::string const& Key)
+	{
+		return shared().Blobs[Key];
+	}
+
+	bool resetState(char const* Title)
+	{
+		check(shared().Running ? Title : nullptr);
+
+		glUseProgram(0);
+		glBindVertexArray(0);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		glBindBuffer(GL_UNIFORM_BUFFER, 0);
+		glBindBuffer(GL_COPY_READ_BUFFER, 0);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		glBindRenderbuffer(GL_RENDERBUFFER, 0);
+		glDepthFunc(GL_LESS);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+		glPixelStorei(GL_PACK_ALIGNMENT, 4);
+
+		for(std::size_t i = 0; i < sizeof(Capabilities) / sizeof(Capabilities[0]); ++i)
+		{
+			if(defaultCapability(Capabilities[i].Cap))
+				glEnable(Capabilities[i].Cap);
+			else
+				glDisable(Capabilities[i].Cap);
+		}
+
+		GLint TextureUnits(0);
+		glGetIntegerv(GL_MAX_COMBINED_TEXTURE_IMAGE_UNITS, &TextureUnits);
+		for(GLint Unit = 0; Unit < TextureUnits; ++Unit)
+		{
+			glActiveTexture(GLenum(GL_TEXTURE0 + Unit));
+			for(std::size_t i = 0; i < sizeof(TextureTargets) / sizeof(TextureTargets[0]); ++i)
+				glBindTexture(TextureTargets[i].Target, 0);
+		}
+		glActiveTexture(GL_TEXTURE0);
+
+		GLint UniformBindings(0);
+		glGetIntegerv(GL_MAX_UNIFORM_BUFFER_BINDINGS, &UniformBindings);
+		for(GLint Index = 0; Index < UniformBindings; ++Index)
+			glBindBufferBase(GL_UNIFORM_BUFFER, GLuint(Index), 0);
+
+		return check(nullptr) == 0;
+	}
+}//namespace batch
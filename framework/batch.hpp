@@ -0,0 +1,59 @@
+#pragma once
+
+#include "test.hpp"
+#include "asset_pack.hpp"
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// Samples built with GLF_BATCH register themselves instead of defining main(), the batch runner
+// links many of them into one process and runs them in sequence. Registration happens in static
+// initializers, link the sample objects directly rather than through a static library or the
+// linker drops them.
+//
+// What a sample finds here survives from one sample to the next within the process: program
+// binaries and CPU side blobs such as decoded textures.
+namespace batch
+{
+	typedef int (*main_function)(int argc, char* argv[]);
+
+	struct unit
+	{
+		char const* Name;
+		main_function Main;
+	};
+
+	// Returns true so that it can initialize a static
+	bool add(char const* Name, main_function Main);
+	std::vector<unit> const& units();
+
+	// Called by the runner before the first sample, reads --program-cache <dir>
+	void configure(int argc, char* argv[]);
+
+	// GL_ARB_get_program_binary as checked by the framework in the sample's begin(), the program
+	// cache stays off until a sample reports it
+	void setProgramBinary(bool Supported);
+
+	// Title and the name and digest of each source. Packed sources are hashed from the mapped pack,
+	// loose files in the data directory by size and modification time, nothing is read from disk.
+	// Null sources are skipped.
+	std::string programKey(pack::reader const& Pack, char const* Title, char const* const* Sources, std::size_t Count);
+
+	// Program binaries through GL_ARB_get_program_binary, kept in memory and on disk with
+	// --program-cache. Key holds whatever identifies the sources, e.g. programKey(). load() before
+	// attaching shaders, on a miss it returns false and asks the driver to keep the binary
+	// retrievable. store() after a successful link.
+	bool loadProgram(GLuint ProgramName, std::string const& Key);
+	void storeProgram(GLuint ProgramName, std::string const& Key);
+
+	// Process wide storage, empty the first time a key is asked for
+	std::vector<unsigned char>& blob(std::string const& Key);
+
+	// Called first in end(), before the sample deletes its objects: deleting a bound object unbinds
+	// it, so what was left bound is only visible while the objects still exist. Under the runner,
+	// state a sample doesn't normally leave behind is reported on stderr, e.g. a framebuffer, a
+	// capability or a pixel store value. The program, VAO, textures and uniform buffers bound by
+	// the last draw are reset silently. Then the default GL state is restored.
+	// Returns whether the restored state checks out, GL errors are left to the caller's checkError
+	bool resetState(char const* Title);
+}//namespace batch
@@ -0,0 +1,217 @@
+#include "benchmark.hpp"
+#include "options.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+namespace
+{
+	bool hasSuffix(std::string const& String, char const* Suffix)
+	{
+		std::size_t const Length = std::strlen(Suffix);
+		return String.size() >= Length && String.compare(String.size() - Length, Length, Suffix) == 0;
+	}
+}//namespace
+
+benchmark::benchmark(int argc, char* argv[]) :
+	Enabled(options::find(argc, argv, "--benchmark") != nullptr),
+	WarmupFrames(options::count(argc, argv, "--benchmark-warmup", 60)),
+	MeasuredFrames(glm::max<std::size_t>(options::count(argc, argv, "--benchmark-frames", 600), 1)),
+	Budget(0.0),
+	Frame(0),
+	TimerQuery(false)
+{
+	if(char const* Value = options::find(argc, argv, "--benchmark-budget"))
+		this->Budget = std::atof(Value);
+	if(char const* Value = options::find(argc, argv, "--benchmark-output"))
+		this->Output = Value;
+
+	if(this->Enabled)
+	{
+		this->FrameTime.reserve(this->MeasuredFrames);
+		this->CPUTime.reserve(this->MeasuredFrames);
+		this->GPUTime.reserve(this->MeasuredFrames);
+	}
+
+	std::fill(this->QueryName, this->QueryName + QUERY_LATENCY, 0);
+	std::fill(this->QueryFrame, this->QueryFrame + QUERY_LATENCY, 0);
+	std::fill(this->QueryPending, this->QueryPending + QUERY_LATENCY, false);
+}
+
+glm::uvec2 benchmark::windowSize(int argc, char* argv[])
+{
+	glm::uvec2 WindowSize(640, 480);
+	if(char const* Value = options::find(argc, argv, "--benchmark-size"))
+	{
+		unsigned int Width(0), Height(0);
+		if(std::sscanf(Value, "%ux%u", &Width, &Height) == 2 && Width > 0 && Height > 0)
+			WindowSize = glm::uvec2(Width, Height);
+	}
+	return WindowSize;
+}
+
+std::size_t benchmark::frameCount(int argc, char* argv[])
+{
+	if(!options::find(argc, argv, "--benchmark"))
+		return 2;
+
+	// One more frame to close the interval of the last measured frame
+	return options::count(argc, argv, "--benchmark-warmup", 60) + glm::max<std::size_t>(options::count(argc, argv, "--benchmark-frames", 600), 1) + 1;
+}
+
+bool benchmark::enabled() const
+{
+	return this->Enabled;
+}
+
+void benchmark::setTimerQuery(bool Supported)
+{
+	this->TimerQuery = Supported;
+}
+
+void benchmark::resolve(std::size_t Slot, bool Wait)
+{
+	if(!this->QueryPending[Slot])
+		return;
+
+	if(!Wait)
+	{
+		GLint Available(GL_FALSE);
+		glGetQueryObjectiv(this->QueryName[Slot], GL_QUERY_RESULT_AVAILABLE, &Available);
+		if(Available == GL_FALSE)
+			return;
+	}
+
+	GLuint64 Elapsed(0);
+	glGetQueryObjectui64v(this->QueryName[Slot], GL_QUERY_RESULT, &Elapsed);
+	this->QueryPending[Slot] = false;
+
+	if(this->QueryFrame[Slot] >= this->WarmupFrames && this->GPUTime.size() < this->MeasuredFrames)
+		this->GPUTime.push_back(double(Elapsed) * 1e-6);
+}
+
+void benchmark::begin()
+{
+	if(!this->Enabled)
+		return;
+
+	if(this->Frame == 0 && this->TimerQuery)
+		glGenQueries(QUERY_LATENCY, this->QueryName);
+
+	this->PreviousFrameStart = this->FrameStart;
+	this->FrameStart = clock::now();
+
+	bool const Measured = this->Frame > this->WarmupFrames && this->Frame <= this->WarmupFrames + this->MeasuredFrames;
+	if(Measured)
+		this->FrameTime.push_back(std::chrono::duration<double, std::milli>(this->FrameStart - this->PreviousFrameStart).count());
+	if(this->Frame == this->WarmupFrames)
+		this->MeasureStart = this->FrameStart;
+	if(this->Frame == this->WarmupFrames + this->MeasuredFrames)
+		this->MeasureEnd = this->FrameStart;
+
+	if(this->TimerQuery)
+	{
+		std::size_t const Slot = this->Frame % QUERY_LATENCY;
+		this->resolve(Slot, true);
+		this->QueryFrame[Slot] = this->Frame;
+		glBeginQuery(GL_TIME_ELAPSED, this->QueryName[Slot]);
+	}
+}
+
+void benchmark::end()
+{
+	if(!this->Enabled)
+		return;
+
+	if(this->Frame >= this->WarmupFrames && this->CPUTime.size() < this->MeasuredFrames)
+		this->CPUTime.push_back(std::chrono::duration<double, std::milli>(clock::now() - this->FrameStart).count());
+
+	if(this->TimerQuery)
+	{
+		std::size_t const Slot = this->Frame % QUERY_LATENCY;
+		glEndQuery(GL_TIME_ELAPSED);
+		this->QueryPending[Slot] = true;
+
+		for(std::size_t i = 0; i < QUERY_LATENCY; ++i)
+			this->resolve(i, false);
+	}
+
+	++this->Frame;
+}
+
+benchmark::stats benchmark::compute(std::vector<double> Samples)
+{
+	stats Stats = {-1.0, -1.0, -1.0, -1.0, -1.0};
+	if(Samples.empty())
+		return Stats;
+
+	std::sort(Samples.begin(), Samples.end());
+
+	double Sum(0.0);
+	for(std::size_t i = 0; i < Samples.size(); ++i)
+		Sum += Samples[i];
+
+	// Nearest rank percentiles
+	std::size_t const Last = Samples.size() - 1;
+	Stats.Mean = Sum / double(Samples.size());
+	Stats.P50 = Samples[Last * 50 / 100];
+	Stats.P95 = Samples[Last * 95 / 100];
+	Stats.P99 = Samples[Last * 99 / 100];
+	Stats.Max = Samples[Last];
+	return Stats;
+}
+
+bool benchmark::save(std::string const& Title)
+{
+	if(!this->Enabled)
+		return true;
+
+	if(this->TimerQuery)
+	{
+		for(std::size_t i = 0; i < QUERY_LATENCY; ++i)
+			this->resolve(i, true);
+		glDeleteQueries(QUERY_LATENCY, this->QueryName);
+		this->TimerQuery = false;
+	}
+
+	stats const Frame = compute(this->FrameTime);
+	stats const CPU = compute(this->CPUTime);
+	stats const GPU = compute(this->GPUTime);
+
+	bool const Completed = this->FrameTime.size() == this->MeasuredFrames;
+	double const Seconds = std::chrono::duration<double>(this->MeasureEnd - this->MeasureStart).count();
+	double const FramesPerSecond = Completed && Seconds > 0.0 ? double(this->MeasuredFrames) / Seconds : -1.0;
+	bool const WithinBudget = this->Budget <= 0.0 || (Completed && Frame.P95 <= this->Budget);
+
+	FILE* File = this->Output.empty() ? stdout : std::fopen(this->Output.c_str(), "w");
+	if(!File)
+		return false;
+
+	stats const* Stats[] = {&Frame, &CPU, &GPU};
+	char const* Names[] = {"frame", "cpu", "gpu"};
+
+	if(hasSuffix(this->Output, ".csv"))
+	{
+		std::fprintf(File, "sample,metric,mean_ms,p50_ms,p95_ms,p99_ms,max_ms,fps,frames,budget_ms,pass\n");
+		for(std::size_t i = 0; i < 3; ++i)
+			std::fprintf(File, "%s,%s,%.4f,%.4f,%.4f,%.4f,%.4f,%.2f,%u,%.4f,%d\n",
+				Title.c_str(), Names[i], Stats[i]->Mean, Stats[i]->P50, Stats[i]->P95, Stats[i]->P99, Stats[i]->Max,
+				FramesPerSecond, unsigned(this->FrameTime.size()), this->Budget, WithinBudget ? 1 : 0);
+	}
+	else
+	{
+		std::fprintf(File, "{\n\t\"sample\": \"%s\",\n\t\"warmup_frames\": %u,\n\t\"measured_frames\": %u,\n",
+			Title.c_str(), unsigned(this->WarmupFrames), unsigned(this->FrameTime.size()));
+		for(std::size_t i = 0; i < 3; ++i)
+			std::fprintf(File, "\t\"%s_ms\": {\"mean\": %.4f, \"p50\": %.4f, \"p95\": %.4f, \"p99\": %.4f, \"max\": %.4f},\n",
+				Names[i], Stats[i]->Mean, Stats[i]->P50, Stats[i]->P95, Stats[i]->P99, Stats[i]->Max);
+		std::fprintf(File, "\t\"fps\": %.2f,\n\t\"budget_ms\": %.4f,\n\t\"pass\": %s\n}\n",
+			FramesPerSecond, this->Budget, WithinBudget ? "true" : "false");
+	}
+
+	if(File != stdout)
+		std::fclose(File);
+
+	return WithinBudget;
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include "test.hpp"
+#include <chrono>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// Fixed workload benchmark mode, enabled with --benchmark.
+// --benchmark-warmup <frames>   frames rendered before measuring, 60 by default
+// --benchmark-frames <frames>   measured frames, 600 by default
+// --benchmark-size <W>x<H>      window size, 640x480 by default
+// --benchmark-output <file>     .csv for CSV, JSON otherwise, stdout by default
+// --benchmark-budget <ms>       fails the run when the p95 frame time is above the budget
+class benchmark
+{
+public:
+	benchmark(int argc, char* argv[]);
+
+	// Parsed before the framework is constructed so the window and the run length follow the options
+	static glm::uvec2 windowSize(int argc, char* argv[]);
+	static std::size_t frameCount(int argc, char* argv[]);
+
+	bool enabled() const;
+
+	// GL_ARB_timer_query as checked by the framework, call from begin() before the first frame
+	void setTimerQuery(bool Supported);
+
+	// Bracket the work of render(), nothing is allocated between the two calls
+	void begin();
+	void end();
+
+	// Writes the report, returns false when the budget is exceeded
+	bool save(std::string const& Title);
+
+private:
+	typedef std::chrono::steady_clock clock;
+
+	enum
+	{
+		QUERY_LATENCY = 4
+	};
+
+	struct stats
+	{
+		double Mean;
+		double P50;
+		double P95;
+		double P99;
+		double Max;
+	};
+
+	static stats compute(std::vector<double> Samples);
+	void resolve(std::size_t Slot, bool Wait);
+
+	bool Enabled;
+	std::size_t WarmupFrames;
+	std::size_t MeasuredFrames;
+	double Budget;
+	std::string Output;
+
+	std::size_t Frame;
+	clock::time_point FrameStart;
+	clock::time_point PreviousFrameStart;
+	clock::time_point MeasureStart;
+	clock::time_point MeasureEnd;
+	std::vector<double> FrameTime;
+	std::vector<double> CPUTime;
+	std::vector<double> GPUTime;
+	GLuint QueryName[QUERY_LATENCY];
+	std::size_t QueryFrame[QUERY_LATENCY];
+	bool QueryPending[QUERY_LATENCY];
+	bool TimerQuery;
+};
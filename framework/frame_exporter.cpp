@@ -0,0 +1,712 @@
+#include "frame_exporter.hpp"
+#include "options.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <utility>
+
+#if defined(GLF_FRAME_EXPORT_ZLIB)
+#	include <zlib.h>
+#endif
+
+namespace
+{
+	void append(std::vector<unsigned char>& Data, void const* Source, std::size_t Size)
+	{
+		unsigned char const* Bytes = static_cast<unsigned char const*>(Source);
+		Data.insert(Data.end(), Bytes, Bytes + Size);
+	}
+
+	void appendBigEndian(std::vector<unsigned char>& Data, unsigned int Value)
+	{
+		unsigned char const Bytes[] = {
+			static_cast<unsigned char>(Value >> 24), static_cast<unsigned char>(Value >> 16),
+			static_cast<unsigned char>(Value >> 8), static_cast<unsigned char>(Value)};
+		append(Data, Bytes, sizeof(Bytes));
+	}
+
+	template <typename genType>
+	void appendLittleEndian(std::vector<unsigned char>& Data, genType Value)
+	{
+		append(Data, &Value, sizeof(Value));
+	}
+
+	struct crc32_table
+	{
+		crc32_table()
+		{
+			for(unsigned int i = 0; i < 256; ++i)
+			{
+				unsigned int Value = i;
+				for(int k = 0; k < 8; ++k)
+					Value = Value & 1 ? 0xEDB88320u ^ (Value >> 1) : Value >> 1;
+				this->Data[i] = Value;
+			}
+		}
+
+		unsigned int Data[256];
+	};
+
+	unsigned int crc32(unsigned char const* Data, std::size_t Size, unsigned int Crc = 0)
+	{
+		// Encoder threads hash concurrently, the table is built once by the static initialization
+		static crc32_table const Table;
+
+		Crc = ~Crc;
+		for(std::size_t i = 0; i < Size; ++i)
+			Crc = Table.Data[(Crc ^ Data[i]) & 0xFF] ^ (Crc >> 8);
+		return ~Crc;
+	}
+
+	void appendChunk(std::vector<unsigned char>& File, char const* Type, std::vector<unsigned char> const& Data)
+	{
+		appendBigEndian(File, unsigned(Data.size()));
+		std::size_t const Start = File.size();
+		append(File, Type, 4);
+		if(!Data.empty())
+			append(File, &Data[0], Data.size());
+		appendBigEndian(File, crc32(&File[Start], File.size() - Start));
+	}
+
+#if !defined(GLF_FRAME_EXPORT_ZLIB)
+	// Largest n such that 255n(n+1)/2 + (n+1)(65521-1) fits in 32 bits, the sums are only
+	// reduced once every NMAX bytes, as zlib does
+	std::size_t const ADLER32_NMAX = 5552;
+
+	unsigned int adler32(unsigned char const* Data, std::size_t Size)
+	{
+		unsigned int A(1), B(0);
+		while(Size > 0)
+		{
+			std::size_t const Count = std::min(Size, ADLER32_NMAX);
+			for(std::size_t i = 0; i < Count; ++i)
+			{
+				A += Data[i];
+				B += A;
+			}
+			A %= 65521;
+			B %= 65521;
+			Data += Count;
+			Size -= Count;
+		}
+		return (B << 16) | A;
+	}
+
+	// Deflate bits go out least significant bit first, Huffman codes most significant bit first
+	class bit_writer
+	{
+	public:
+		explicit bit_writer(std::vector<unsigned char>& Stream) :
+			Stream(Stream),
+			Bits(0),
+			Count(0)
+		{}
+
+		void bits(unsigned int Value, unsigned int Length)
+		{
+			this->Bits |= static_cast<unsigned long long>(Value) << this->Count;
+			this->Count += Length;
+			while(this->Count >= 8)
+			{
+				this->Stream.push_back(static_cast<unsigned char>(this->Bits));
+				this->Bits >>= 8;
+				this->Count -= 8;
+			}
+		}
+
+		void code(unsigned int Code, unsigned int Length)
+		{
+			unsigned int Reversed(0);
+			for(unsigned int i = 0; i < Length; ++i)
+				Reversed |= ((Code >> i) & 1) << (Length - 1 - i);
+			this->bits(Reversed, Length);
+		}
+
+		void flush()
+		{
+			if(this->Count > 0)
+				this->Stream.push_back(static_cast<unsigned char>(this->Bits));
+			this->Bits = 0;
+			this->Count = 0;
+		}
+
+	private:
+		std::vector<unsigned char>& Stream;
+		unsigned long long Bits;
+		unsigned int Count;
+	};
+
+	// Fixed literal/length code of RFC 1951 3.2.6
+	void literal(bit_writer& Writer, unsigned int Symbol)
+	{
+		if(Symbol < 144)
+			Writer.code(0x30 + Symbol, 8);
+		else if(Symbol < 256)
+			Writer.code(0x190 + Symbol - 144, 9);
+		else if(Symbol < 280)
+			Writer.code(Symbol - 256, 7);
+		else
+			Writer.code(0xC0 + Symbol - 280, 8);
+	}
+
+	unsigned short const LengthBase[] = {3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+	unsigned char const LengthExtra[] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+	unsigned short const DistanceBase[] = {1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+	unsigned char const DistanceExtra[] = {0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+
+	void match(bit_writer& Writer, std::size_t Length, std::size_t Distance)
+	{
+		std::size_t L = sizeof(LengthBase) / sizeof(LengthBase[0]) - 1;
+		while(LengthBase[L] > Length)
+			--L;
+		literal(Writer, unsigned(257 + L));
+		Writer.bits(unsigned(Length - LengthBase[L]), LengthExtra[L]);
+
+		std::size_t D = sizeof(DistanceBase) / sizeof(DistanceBase[0]) - 1;
+		while(DistanceBase[D] > Distance)
+			--D;
+		Writer.code(unsigned(D), 5);
+		Writer.bits(unsigned(Distance - DistanceBase[D]), DistanceExtra[D]);
+	}
+
+	std::size_t const WINDOW_SIZE = 32768;
+	std::size_t const MIN_MATCH = 3;
+	std::size_t const MAX_MATCH = 258;
+	std::size_t const HASH_BITS = 15;
+	// Candidates tried per position, the speed side of zlib's fast levels
+	std::size_t const MAX_CHAIN = 8;
+
+	unsigned int hash(unsigned char const* Data)
+	{
+		unsigned int const Value = unsigned(Data[0]) | (unsigned(Data[1]) << 8) | (unsigned(Data[2]) << 16);
+		return (Value * 2654435761u) >> (32 - HASH_BITS);
+	}
+
+	// Stored blocks after the zlib header, for data the fixed codes would expand such as noise
+	void store(std::vector<unsigned char> const& Rows, std::vector<unsigned char>& Stream)
+	{
+		std::size_t Offset(0);
+		do
+		{
+			std::size_t const Size = std::min<std::size_t>(Rows.size() - Offset, 65535);
+			bool const Final = Offset + Size == Rows.size();
+			Stream.push_back(Final ? 1 : 0);
+			appendLittleEndian(Stream, static_cast<unsigned short>(Size));
+			appendLittleEndian(Stream, static_cast<unsigned short>(~Size));
+			if(Size > 0)
+				append(Stream, &Rows[Offset], Size);
+			Offset += Size;
+		}
+		while(Offset < Rows.size());
+	}
+#endif
+
+	// zlib stream of the filtered scanlines. Without zlib, one deflate block with the fixed Huffman
+	// codes and greedy LZ77 matching over hash chains: filtered rendered frames are mostly runs,
+	// which fixed codes already shrink well, and there is no code table to build per frame
+	void deflate(std::vector<unsigned char> const& Rows, std::vector<unsigned char>& Stream)
+	{
+#if defined(GLF_FRAME_EXPORT_ZLIB)
+		uLongf Size = compressBound(uLong(Rows.size()));
+		Stream.resize(Size);
+		compress2(&Stream[0], &Size, &Rows[0], uLong(Rows.size()), Z_BEST_SPEED);
+		Stream.resize(Size);
+#else
+		Stream.reserve(Rows.size() / 2);
+		Stream.push_back(0x78);
+		Stream.push_back(0x01);
+
+		bit_writer Writer(Stream);
+		Writer.bits(1, 1); // BFINAL
+		Writer.bits(1, 2); // BTYPE fixed Huffman
+
+		std::vector<std::size_t> Head(std::size_t(1) << HASH_BITS, ~std::size_t(0));
+		std::vector<std::size_t> Previous(WINDOW_SIZE, ~std::size_t(0));
+
+		unsigned char const* Data = Rows.empty() ? nullptr : &Rows[0];
+		std::size_t const Size = Rows.size();
+		std::size_t Position(0);
+		while(Position < Size)
+		{
+			std::size_t BestLength(0);
+			std::size_t BestDistance(0);
+			if(Position + MIN_MATCH <= Size)
+			{
+				unsigned int const Hash = hash(Data + Position);
+				std::size_t const Limit = std::min(MAX_MATCH, Size - Position);
+				std::size_t Candidate = Head[Hash];
+				for(std::size_t Chain = 0; Chain < MAX_CHAIN && Candidate != ~std::size_t(0) && Position - Candidate <= WINDOW_SIZE; ++Chain)
+				{
+					std::size_t Length(0);
+					while(Length < Limit && Data[Candidate + Length] == Data[Position + Length])
+						++Length;
+					if(Length > BestLength)
+					{
+						BestLength = Length;
+						BestDistance = Position - Candidate;
+						if(Length == Limit)
+							break;
+					}
+					Candidate = Previous[Candidate % WINDOW_SIZE];
+				}
+			}
+
+			std::size_t const Advance = BestLength >= MIN_MATCH ? BestLength : 1;
+			if(BestLength >= MIN_MATCH)
+				match(Writer, BestLength, BestDistance);
+			else
+				literal(Writer, Data[Position]);
+
+			// Every position covered enters the chains, so later matches can start inside this one
+			for(std::size_t i = 0; i < Advance; ++i, ++Position)
+			{
+				if(Position + MIN_MATCH > Size)
+					continue;
+				unsigned int const Hash = hash(Data + Position);
+				Previous[Position % WINDOW_SIZE] = Head[Hash];
+				Head[Hash] = Position;
+			}
+		}
+
+		literal(Writer, 256);
+		Writer.flush();
+
+		// Each stored block costs 5 bytes, keep whichever is smaller
+		std::size_t const StoredSize = 2 + Size + 5 * std::max<std::size_t>(1, (Size + 65534) / 65535);
+		if(Stream.size() > StoredSize)
+		{
+			Stream.resize(2);
+			store(Rows, Stream);
+		}
+
+		appendBigEndian(Stream, Size == 0 ? 1u : adler32(Data, Size));
+#endif
+	}
+
+	bool write(std::string const& Filename, std::vector<unsigned char> const& Data)
+	{
+		FILE* File = std::fopen(Filename.c_str(), "wb");
+		if(!File)
+			return false;
+		bool const Written = std::fwrite(&Data[0], 1, Data.size(), File) == Data.size();
+		return std::fclose(File) == 0 && Written;
+	}
+
+	// RGBA8 rows bottom up, as read by glReadPixels
+	bool writePNG(std::string const& Filename, glm::ivec2 const& Size, std::vector<unsigned char> const& Pixels)
+	{
+		std::size_t const Pitch = std::size_t(Size.x) * 4;
+
+		// Sub filter: each byte minus the same channel of the pixel on its left, flat and smoothly
+		// shaded areas become runs of small values
+		std::vector<unsigned char> Rows;
+		Rows.reserve((Pitch + 1) * std::size_t(Size.y));
+		for(int y = Size.y - 1; y >= 0; --y)
+		{
+			unsigned char const* Row = &Pixels[std::size_t(y) * Pitch];
+			Rows.push_back(1);
+			append(Rows, Row, std::min<std::size_t>(Pitch, 4));
+			for(std::size_t i = 4; i < Pitch; ++i)
+				Rows.push_back(static_cast<unsigned char>(Row[i] - Row[i - 4]));
+		}
+
+		std::vector<unsigned char> Header;
+		appendBigEndian(Header, unsigned(Size.x));
+		appendBigEndian(Header, unsigned(Size.y));
+		unsigned char const Format[] = {8, 6, 0, 0, 0};
+		append(Header, Format, sizeof(Format));
+
+		std::vector<unsigned char> Stream;
+		deflate(Rows, Stream);
+
+		unsigned char const Signature[] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+		std::vector<unsigned char> File;
+		append(File, Signature, sizeof(Signature));
+		appendChunk(File, "IHDR", Header);
+		appendChunk(File, "IDAT", Stream);
+		appendChunk(File, "IEND", std::vector<unsigned char>());
+
+		return write(Filename, File);
+	}
+
+	void appendAttribute(std::vector<unsigned char>& File, char const* Name, char const* Type, std::vector<unsigned char> const& Value)
+	{
+		append(File, Name, std::strlen(Name) + 1);
+		append(File, Type, std::strlen(Type) + 1);
+		appendLittleEndian(File, int(Value.size()));
+		append(File, &Value[0], Value.size());
+	}
+
+	// Uncompressed scanline OpenEXR of 32 bit float channels, RGBA rows bottom up as read by glReadPixels
+	bool writeEXR(std::string const& Filename, glm::ivec2 const& Size, std::vector<unsigned char> const& Pixels)
+	{
+		float const* Texels = reinterpret_cast<float const*>(&Pixels[0]);
+
+		// Channels are stored in alphabetical order
+		char const* const Names[] = {"A", "B", "G", "R"};
+		std::size_t const Component[] = {3, 2, 1, 0};
+
+		std::vector<unsigned char> Channels;
+		for(std::size_t i = 0; i < 4; ++i)
+		{
+			append(Channels, Names[i], 2);
+			appendLittleEndian(Channels, int(2));
+			unsigned char const Linear[] = {0, 0, 0, 0};
+			append(Channels, Linear, sizeof(Linear));
+			appendLittleEndian(Channels, int(1));
+			appendLittleEndian(Channels, int(1));
+		}
+		Channels.push_back(0);
+
+		std::vector<unsigned char> Window;
+		appendLittleEndian(Window, int(0));
+		appendLittleEndian(Window, int(0));
+		appendLittleEndian(Window, Size.x - 1);
+		appendLittleEndian(Window, Size.y - 1);
+
+		std::vector<unsigned char> Zero(1, 0);
+		std::vector<unsigned char> One;
+		appendLittleEndian(One, 1.0f);
+		std::vector<unsigned char> Center;
+		appendLittleEndian(Center, 0.0f);
+		appendLittleEndian(Center, 0.0f);
+
+		std::vector<unsigned char> File;
+		unsigned char const Magic[] = {0x76, 0x2F, 0x31, 0x01, 2, 0, 0, 0};
+		append(File, Magic, sizeof(Magic));
+		appendAttribute(File, "channels", "chlist", Channels);
+		appendAttribute(File, "compression", "compression", Zero);
+		appendAttribute(File, "dataWindow", "box2i", Window);
+		appendAttribute(File, "displayWindow", "box2i", Window);
+		appendAttribute(File, "lineOrder", "lineOrder", Zero);
+		appendAttribute(File, "pixelAspectRatio", "float", One);
+		appendAttribute(File, "screenWindowCenter", "v2f", Center);
+		appendAttribute(File, "screenWindowWidth", "float", One);
+		File.push_back(0);
+
+		std::size_t const LineSize = std::size_t(Size.x) * 4 * sizeof(float);
+		std::size_t const TableStart = File.size();
+		for(int y = 0; y < Size.y; ++y)
+			appendLittleEndian(File, static_cast<unsigned long long>(TableStart + std::size_t(Size.y) * 8 + std::size_t(y) * (8 + LineSize)));
+
+		for(int y = 0; y < Size.y; ++y)
+		{
+			appendLittleEndian(File, y);
+			appendLittleEndian(File, int(LineSize));
+
+			float const* Row = Texels + std::size_t(Size.y - 1 - y) * std::size_t(Size.x) * 4;
+			for(std::size_t c = 0; c < 4; ++c)
+				for(int x = 0; x < Size.x; ++x)
+					appendLittleEndian(File, Row[std::size_t(x) * 4 + Component[c]]);
+		}
+
+		return write(Filename, File);
+	}
+}//namespace
+
+frame_exporter::frame_exporter(int argc, char* argv[], glm::vec2 const& Orientation, glm::vec2 const& Position) :
+	Enabled(false),
+	FrameCount(options::count(argc, argv, "--export-frames", 120)),
+	ColorFormat(FORMAT_PNG),
+	Depth(options::find(argc, argv, "--export-depth") != nullptr),
+	Orientation(Orientation),
+	Position(Position),
+	Frame(0),
+	ResolveFramebufferName(0),
+	ResolveTextureName(0),
+	ResolveSize(0),
+	QueueCapacity(std::max<std::size_t>(options::count(argc, argv, "--export-queue", 8), 1)),
+	Stop(false),
+	Failed(false)
+{
+	if(char const* Value = options::find(argc, argv, "--export"))
+	{
+		this->Directory = Value;
+		this->Enabled = !this->Directory.empty();
+	}
+	if(char const* Value = options::find(argc, argv, "--export-format"))
+	{
+		if(std::strcmp(Value, "exr") == 0)
+			this->ColorFormat = FORMAT_EXR;
+		else if(std::strcmp(Value, "png") != 0)
+		{
+			// Nothing is exported rather than files in a format that wasn't asked for
+			std::fprintf(stderr, "Unknown --export-format \"%s\", expected png or exr\n", Value);
+			this->Enabled = false;
+			this->Failed = true;
+		}
+	}
+
+	for(std::size_t i = 0; i < READBACK_LATENCY; ++i)
+	{
+		readback const Readback = {0, 0, 0, 0, 0, 0, glm::ivec2(0), glm::ivec2(0)};
+		this->Readback[i] = Readback;
+	}
+
+	if(!this->Enabled)
+		return;
+
+	std::size_t const Hardware = std::thread::hardware_concurrency();
+	std::size_t const ThreadCount = std::max<std::size_t>(options::count(argc, argv, "--export-threads", Hardware > 1 ? Hardware - 1 : 1), 1);
+	for(std::size_t i = 0; i < ThreadCount; ++i)
+		this->Workers.push_back(std::thread(&frame_exporter::work, this));
+}
+
+frame_exporter::~frame_exporter()
+{
+	{
+		std::lock_guard<std::mutex> Lock(this->Mutex);
+		this->Stop = true;
+	}
+	this->NotEmpty.notify_all();
+	for(std::size_t i = 0; i < this->Workers.size(); ++i)
+		if(this->Workers[i].joinable())
+			this->Workers[i].join();
+}
+
+std::size_t frame_exporter::frameCount(int argc, char* argv[], std::size_t Default)
+{
+	char const* Value = options::find(argc, argv, "--export");
+	if(!Value || !*Value)
+		return Default;
+
+	return options::count(argc, argv, "--export-frames", 120) + READBACK_LATENCY;
+}
+
+bool frame_exporter::enabled() const
+{
+	return this->Enabled;
+}
+
+glm::mat4 frame_exporter::view() const
+{
+	// One orbit over the sequence, starting from the framework camera
+	float const Turn = glm::pi<float>() * 2.0f * float(this->Frame) / float(std::max<std::size_t>(this->FrameCount, 1));
+
+	glm::mat4 const Translate = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.0f, -this->Position.y));
+	glm::mat4 const RotateX = glm::rotate(Translate, this->Orientation.y, glm::vec3(1.f, 0.f, 0.f));
+	return glm::rotate(RotateX, this->Orientation.x + Turn, glm::vec3(0.f, 1.f, 0.f));
+}
+
+void frame_exporter::captureDepth(GLuint FramebufferName, glm::ivec2 const& Size)
+{
+	if(!this->Enabled || !this->Depth || this->Frame >= this->FrameCount)
+		return;
+
+	// Single sample copy of the depth, depth blits need the same format on both sides
+	if(this->ResolveSize != Size)
+	{
+		if(!this->ResolveFramebufferName)
+		{
+			glGenFramebuffers(1, &this->ResolveFramebufferName);
+			glGenTextures(1, &this->ResolveTextureName);
+		}
+		glBindTexture(GL_TEXTURE_2D, this->ResolveTextureName);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, Size.x, Size.y, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+		glBindTexture(GL_TEXTURE_2D, 0);
+
+		glBindFramebuffer(GL_FRAMEBUFFER, this->ResolveFramebufferName);
+		glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, this->ResolveTextureName, 0);
+		glDrawBuffer(GL_NONE);
+		glReadBuffer(GL_NONE);
+		this->ResolveSize = Size;
+	}
+
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, FramebufferName);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, this->ResolveFramebufferName);
+	glBlitFramebuffer(0, 0, Size.x, Size.y, 0, 0, Size.x, Size.y, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+
+	readback& Readback = this->Readback[this->Frame % READBACK_LATENCY];
+	GLsizeiptr const BufferSize = GLsizeiptr(Size.x) * Size.y * GLsizeiptr(sizeof(float));
+	if(!Readback.DepthBufferName)
+		glGenBuffers(1, &Readback.DepthBufferName);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, Readback.DepthBufferName);
+	if(Readback.DepthBufferSize != BufferSize)
+	{
+		glBufferData(GL_PIXEL_PACK_BUFFER, BufferSize, NULL, GL_STREAM_READ);
+		Readback.DepthBufferSize = BufferSize;
+	}
+
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, this->ResolveFramebufferName);
+	glReadPixels(0, 0, Size.x, Size.y, GL_DEPTH_COMPONENT, GL_FLOAT, BUFFER_OFFSET(0));
+	Readback.DepthSize = Size;
+
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void frame_exporter::capture(glm::ivec2 const& Size)
+{
+	if(!this->Enabled || this->Frame >= this->FrameCount)
+		return;
+
+	readback& Readback = this->Readback[this->Frame % READBACK_LATENCY];
+	GLsizeiptr const TexelSize = this->ColorFormat == FORMAT_EXR ? GLsizeiptr(sizeof(float) * 4) : 4;
+	GLsizeiptr const BufferSize = GLsizeiptr(Size.x) * Size.y * TexelSize;
+	if(!Readback.ColorBufferName)
+		glGenBuffers(1, &Readback.ColorBufferName);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, Readback.ColorBufferName);
+	if(Readback.ColorBufferSize != BufferSize)
+	{
+		glBufferData(GL_PIXEL_PACK_BUFFER, BufferSize, NULL, GL_STREAM_READ);
+		Readback.ColorBufferSize = BufferSize;
+	}
+
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+	glReadBuffer(GL_BACK);
+	glReadPixels(0, 0, Size.x, Size.y, GL_RGBA, this->ColorFormat == FORMAT_EXR ? GL_FLOAT : GL_UNSIGNED_BYTE, BUFFER_OFFSET(0));
+	Readback.ColorSize = Size;
+
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+
+void frame_exporter::end()
+{
+	if(!this->Enabled)
+		return;
+
+	if(this->Frame < this->FrameCount)
+	{
+		readback& Readback = this->Readback[this->Frame % READBACK_LATENCY];
+		Readback.Fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		Readback.Frame = this->Frame;
+	}
+
+	++this->Frame;
+
+	// The slot of the next frame was filled READBACK_LATENCY - 1 frames ago, it's usually ready
+	readback& Next = this->Readback[this->Frame % READBACK_LATENCY];
+	if(Next.Fence)
+		this->resolve(Next);
+}
+
+void frame_exporter::resolve(readback& Readback)
+{
+	GLenum Result = glClientWaitSync(Readback.Fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+	while(Result == GL_TIMEOUT_EXPIRED)
+		Result = glClientWaitSync(Readback.Fence, 0, 1000000);
+	glDeleteSync(Readback.Fence);
+	Readback.Fence = 0;
+
+	char Name[64];
+	if(Readback.ColorSize.x > 0)
+	{
+		job Job;
+		std::sprintf(Name, "/color_%05u.%s", unsigned(Readback.Frame), this->ColorFormat == FORMAT_EXR ? "exr" : "png");
+		Job.Filename = this->Directory + Name;
+		Job.Format = this->ColorFormat;
+		Job.Size = Readback.ColorSize;
+		Job.Data.resize(std::size_t(Readback.ColorBufferSize));
+
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, Readback.ColorBufferName);
+		void const* Pointer = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, Readback.ColorBufferSize, GL_MAP_READ_BIT);
+		std::memcpy(&Job.Data[0], Pointer, Job.Data.size());
+		glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+
+		this->push(Job);
+		Readback.ColorSize = glm::ivec2(0);
+	}
+
+	if(Readback.DepthSize.x > 0)
+	{
+		job Job;
+		std::sprintf(Name, "/depth_%05u_%dx%d.raw", unsigned(Readback.Frame), Readback.DepthSize.x, Readback.DepthSize.y);
+		Job.Filename = this->Directory + Name;
+		Job.Format = FORMAT_DEPTH;
+		Job.Size = Readback.DepthSize;
+		Job.Data.resize(std::size_t(Readback.DepthBufferSize));
+
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, Readback.DepthBufferName);
+		void const* Pointer = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, Readback.DepthBufferSize, GL_MAP_READ_BIT);
+		std::memcpy(&Job.Data[0], Pointer, Job.Data.size());
+		glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+
+		this->push(Job);
+		Readback.DepthSize = glm::ivec2(0);
+	}
+
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+
+// Blocks while the queue is full so that render() can't get ahead of the encoders without bound
+void frame_exporter::push(job& Job)
+{
+	std::unique_lock<std::mutex> Lock(this->Mutex);
+	this->NotFull.wait(Lock, [this]() { return this->Queue.size() < this->QueueCapacity; });
+	this->Queue.push_back(job());
+	std::swap(this->Queue.back(), Job);
+	Lock.unlock();
+	this->NotEmpty.notify_one();
+}
+
+void frame_exporter::work()
+{
+	for(;;)
+	{
+		job Job;
+		{
+			std::unique_lock<std::mutex> Lock(this->Mutex);
+			this->NotEmpty.wait(Lock, [this]() { return this->Stop || !this->Queue.empty(); });
+			if(this->Queue.empty())
+				return;
+			std::swap(Job, this->Queue.front());
+			this->Queue.pop_front();
+		}
+		this->NotFull.notify_one();
+
+		bool Written = false;
+		switch(Job.Format)
+		{
+		case FORMAT_PNG:
+			Written = writePNG(Job.Filename, Job.Size, Job.Data);
+			break;
+		case FORMAT_EXR:
+			Written = writeEXR(Job.Filename, Job.Size, Job.Data);
+			break;
+		case FORMAT_DEPTH:
+			// 32 bit float depth in [0, 1], rows bottom up as glReadPixels returns them
+			Written = write(Job.Filename, Job.Data);
+			break;
+		}
+
+		if(!Written)
+		{
+			std::lock_guard<std::mutex> Lock(this->Mutex);
+			this->Failed = true;
+			std::fprintf(stderr, "Can't write %s\n", Job.Filename.c_str());
+		}
+	}
+}
+
+bool frame_exporter::save()
+{
+	if(!this->Enabled)
+		return !this->Failed;
+
+	// Oldest first so files come out in frame order
+	for(std::size_t i = 0; i < READBACK_LATENCY; ++i)
+	{
+		readback& Readback = this->Readback[(this->Frame + i) % READBACK_LATENCY];
+		if(Readback.Fence)
+			this->resolve(Readback);
+	}
+
+	{
+		std::lock_guard<std::mutex> Lock(this->Mutex);
+		this->Stop = true;
+	}
+	this->NotEmpty.notify_all();
+	for(std::size_t i = 0; i < this->Workers.size(); ++i)
+		this->Workers[i].join();
+	this->Workers.clear();
+
+	for(std::size_t i = 0; i < READBACK_LATENCY; ++i)
+	{
+		glDeleteBuffers(1, &this->Readback[i].ColorBufferName);
+		glDeleteBuffers(1, &this->Readback[i].DepthBufferName);
+	}
+	glDeleteFramebuffers(1, &this->ResolveFramebufferName);
+	glDeleteTextures(1, &this->ResolveTextureName);
+
+	return !this->Failed;
+}
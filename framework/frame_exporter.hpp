@@ -0,0 +1,113 @@
+#pragma once
+
+#include "test.hpp"
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Offline rendering of a fixed sequence, every frame written to disk. Enabled with --export.
+// --export <directory>         existing directory receiving color_NNNNN.png|exr and depth files
+// --export-frames <n>          length of the sequence, 120 by default
+// --export-format png|exr      color format, PNG by default, EXR keeps 32 bit float channels,
+//                              any other value disables the export and makes save() fail
+// --export-depth               also writes the resolved depth of the pass given to captureDepth()
+// --export-threads <n>         encoder threads, one less than the hardware threads by default
+// --export-queue <n>           frames waiting for an encoder before render() blocks, 8 by default
+//
+// Frames are read back through a ring of pixel pack buffers, render() only maps a buffer once
+// its fence has signaled. Encoding happens on a thread pool while the next frames render.
+// PNG rows use the Sub filter and are compressed with zlib when built with
+// GLF_FRAME_EXPORT_ZLIB, otherwise with a built in fixed Huffman deflate of similar ratio.
+class frame_exporter
+{
+public:
+	// Orientation and Position as given to the framework, the sequence orbits around the scene
+	frame_exporter(int argc, char* argv[], glm::vec2 const& Orientation, glm::vec2 const& Position);
+	~frame_exporter();
+
+	// Frame count for the framework, the sequence plus the frames draining the readback ring
+	static std::size_t frameCount(int argc, char* argv[], std::size_t Default);
+
+	bool enabled() const;
+
+	// Camera of the current frame, only depends on the frame index
+	glm::mat4 view() const;
+
+	// Resolves the depth attachment of a multisample framebuffer and reads it back as float
+	void captureDepth(GLuint FramebufferName, glm::ivec2 const& Size);
+	// Reads back the back buffer, call after the last pass
+	void capture(glm::ivec2 const& Size);
+	// Last call of render(), hands the finished readbacks to the encoders
+	void end();
+
+	// Drains the ring and the encoders, returns false when a file couldn't be written or the
+	// options were rejected
+	bool save();
+
+private:
+	frame_exporter(frame_exporter const&);
+	frame_exporter& operator=(frame_exporter const&);
+
+	enum
+	{
+		READBACK_LATENCY = 3
+	};
+
+	enum format
+	{
+		FORMAT_PNG,
+		FORMAT_EXR,
+		FORMAT_DEPTH
+	};
+
+	struct readback
+	{
+		GLuint ColorBufferName;
+		GLuint DepthBufferName;
+		GLsizeiptr ColorBufferSize;
+		GLsizeiptr DepthBufferSize;
+		GLsync Fence;
+		std::size_t Frame;
+		glm::ivec2 ColorSize;
+		glm::ivec2 DepthSize;
+	};
+
+	struct job
+	{
+		std::string Filename;
+		format Format;
+		glm::ivec2 Size;
+		std::vector<unsigned char> Data;
+	};
+
+	void resolve(readback& Readback);
+	void push(job& Job);
+	void work();
+
+	bool Enabled;
+	std::string Directory;
+	std::size_t FrameCount;
+	format ColorFormat;
+	bool Depth;
+	glm::vec2 Orientation;
+	glm::vec2 Position;
+
+	std::size_t Frame;
+	readback Readback[READBACK_LATENCY];
+	GLuint ResolveFramebufferName;
+	GLuint ResolveTextureName;
+	glm::ivec2 ResolveSize;
+
+	std::size_t QueueCapacity;
+	std::deque<job> Queue;
+	std::mutex Mutex;
+	std::condition_variable NotEmpty;
+	std::condition_variable NotFull;
+	bool Stop;
+	bool Failed;
+	std::vector<std::thread> Workers;
+};
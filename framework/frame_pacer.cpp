@@ -0,0 +1,153 @@
+#include "frame_pacer.hpp"
+#include "options.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+
+namespace
+{
+	// Wake up regularly rather than blocking forever on a lost context
+	GLuint64 const WAIT_TIMEOUT(1000000);
+}//namespace
+
+frame_pacer::frame_pacer(int argc, char* argv[]) :
+	FramesInFlight(2),
+	Frame(0),
+	Slot(0),
+	TimerQuery(false),
+	LastGPUEnd(0),
+	WaitCount(0),
+	CPUWait(0.0),
+	CPUWaitMax(0.0),
+	IdleCount(0),
+	GPUIdle(0.0),
+	GPUIdleMax(0.0),
+	GPUBusy(0.0)
+{
+	if(char const* Value = options::find(argc, argv, "--frames-in-flight"))
+		if(*Value)
+			this->FramesInFlight = glm::clamp<std::size_t>(std::strtoul(Value, nullptr, 10), 1, MAX_FRAMES_IN_FLIGHT);
+	if(char const* Value = options::find(argc, argv, "--frame-pacing-output"))
+		this->Output = Value;
+
+	std::fill(this->Fence, this->Fence + MAX_FRAMES_IN_FLIGHT, GLsync(0));
+	std::fill(this->QueryName, this->QueryName + MAX_FRAMES_IN_FLIGHT * 2, 0);
+}
+
+std::size_t frame_pacer::framesInFlight() const
+{
+	return this->FramesInFlight;
+}
+
+std::size_t frame_pacer::slot() const
+{
+	return this->Slot;
+}
+
+void frame_pacer::setTimerQuery(bool Supported)
+{
+	this->TimerQuery = Supported;
+}
+
+void frame_pacer::resolve(std::size_t Slot)
+{
+	if(!this->TimerQuery)
+		return;
+
+	// The fence of the frame is signaled so both timestamps are available without stalling
+	GLuint64 Start(0), End(0);
+	glGetQueryObjectui64v(this->QueryName[Slot * 2 + 0], GL_QUERY_RESULT, &Start);
+	glGetQueryObjectui64v(this->QueryName[Slot * 2 + 1], GL_QUERY_RESULT, &End);
+
+	if(this->LastGPUEnd != 0)
+	{
+		double const Idle = Start > this->LastGPUEnd ? double(Start - this->LastGPUEnd) * 1e-6 : 0.0;
+		this->GPUIdle += Idle;
+		this->GPUIdleMax = std::max(this->GPUIdleMax, Idle);
+		++this->IdleCount;
+	}
+	this->GPUBusy += End > Start ? double(End - Start) * 1e-6 : 0.0;
+	this->LastGPUEnd = End;
+}
+
+void frame_pacer::begin()
+{
+	if(this->Frame == 0 && this->TimerQuery)
+		glGenQueries(GLsizei(this->FramesInFlight * 2), this->QueryName);
+
+	this->Slot = this->Frame % this->FramesInFlight;
+
+	if(this->Fence[this->Slot])
+	{
+		clock::time_point const WaitStart = clock::now();
+
+		// Only the first wait flushes, the fence is in the command stream after that
+		GLenum Result = glClientWaitSync(this->Fence[this->Slot], GL_SYNC_FLUSH_COMMANDS_BIT, WAIT_TIMEOUT);
+		while(Result == GL_TIMEOUT_EXPIRED)
+			Result = glClientWaitSync(this->Fence[this->Slot], 0, WAIT_TIMEOUT);
+
+		double const Wait = std::chrono::duration<double, std::milli>(clock::now() - WaitStart).count();
+		this->CPUWait += Wait;
+		this->CPUWaitMax = std::max(this->CPUWaitMax, Wait);
+		++this->WaitCount;
+
+		glDeleteSync(this->Fence[this->Slot]);
+		this->Fence[this->Slot] = 0;
+
+		this->resolve(this->Slot);
+	}
+
+	if(this->TimerQuery)
+		glQueryCounter(this->QueryName[this->Slot * 2 + 0], GL_TIMESTAMP);
+}
+
+void frame_pacer::end()
+{
+	if(this->TimerQuery)
+		glQueryCounter(this->QueryName[this->Slot * 2 + 1], GL_TIMESTAMP);
+
+	this->Fence[this->Slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+	++this->Frame;
+}
+
+bool frame_pacer::save(std::string const& Title)
+{
+	// Drain in submission order so the GPU idle gaps stay between consecutive frames
+	for(std::size_t i = 0; i < this->FramesInFlight; ++i)
+	{
+		std::size_t const Slot = (this->Frame + i) % this->FramesInFlight;
+		if(!this->Fence[Slot])
+			continue;
+
+		glClientWaitSync(this->Fence[Slot], GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+		glDeleteSync(this->Fence[Slot]);
+		this->Fence[Slot] = 0;
+		this->resolve(Slot);
+	}
+
+	if(this->TimerQuery)
+	{
+		glDeleteQueries(GLsizei(this->FramesInFlight * 2), this->QueryName);
+		this->TimerQuery = false;
+	}
+
+	if(this->Output.empty())
+		return true;
+
+	FILE* File = std::fopen(this->Output.c_str(), "w");
+	if(!File)
+		return false;
+
+	std::fprintf(File, "{\n\t\"sample\": \"%s\",\n\t\"frames_in_flight\": %u,\n\t\"frames\": %u,\n",
+		Title.c_str(), unsigned(this->FramesInFlight), unsigned(this->Frame));
+	std::fprintf(File, "\t\"cpu_wait_ms\": {\"total\": %.4f, \"mean\": %.4f, \"max\": %.4f},\n",
+		this->CPUWait, this->WaitCount ? this->CPUWait / double(this->WaitCount) : 0.0, this->CPUWaitMax);
+	std::fprintf(File, "\t\"gpu_idle_ms\": {\"total\": %.4f, \"mean\": %.4f, \"max\": %.4f},\n",
+		this->GPUIdle, this->IdleCount ? this->GPUIdle / double(this->IdleCount) : 0.0, this->GPUIdleMax);
+	std::fprintf(File, "\t\"gpu_busy_ms\": %.4f\n}\n", this->GPUBusy);
+
+	std::fclose(File);
+
+	return true;
+}
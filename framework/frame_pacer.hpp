@@ -0,0 +1,63 @@
+#pragma once
+
+#include "test.hpp"
+#include <chrono>
+#include <cstddef>
+#include <string>
+
+// Bounds how many frames the CPU may queue ahead of the GPU with one fence per frame.
+// --frames-in-flight <n>           1 to 4, 2 by default. 1 waits for the GPU every frame
+// --frame-pacing-output <file>     writes CPU wait and GPU idle statistics as JSON
+//
+// Per frame data written by the CPU is ring allocated with slot(): once begin() returns, the GPU
+// is done with every command of the frame that last used the same slot.
+class frame_pacer
+{
+public:
+	enum
+	{
+		MAX_FRAMES_IN_FLIGHT = 4
+	};
+
+	frame_pacer(int argc, char* argv[]);
+
+	std::size_t framesInFlight() const;
+
+	// Ring slot of the current frame, valid between begin() and end()
+	std::size_t slot() const;
+
+	// GL_ARB_timer_query as checked by the framework, call from begin() before the first frame
+	void setTimerQuery(bool Supported);
+
+	// Waits on the fence of the frame that used the slot last, first call of render()
+	void begin();
+	// Fences the commands of the frame, last call of render()
+	void end();
+
+	// Waits for the frames still in flight, writes the statistics and deletes the GL objects
+	bool save(std::string const& Title);
+
+private:
+	typedef std::chrono::steady_clock clock;
+
+	void resolve(std::size_t Slot);
+
+	std::size_t FramesInFlight;
+	std::string Output;
+
+	std::size_t Frame;
+	std::size_t Slot;
+	GLsync Fence[MAX_FRAMES_IN_FLIGHT];
+	GLuint QueryName[MAX_FRAMES_IN_FLIGHT * 2];
+	bool TimerQuery;
+
+	// GL_TIMESTAMP of the end of the last resolved frame, 0 before the first one
+	GLuint64 LastGPUEnd;
+	std::size_t WaitCount;
+	double CPUWait;
+	double CPUWaitMax;
+	std::size_t IdleCount;
+	double GPUIdle;
+	double GPUIdleMax;
+	double GPUBusy;
+};
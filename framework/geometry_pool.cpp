@@ -0,0 +1,327 @@
+#include "geometry_pool.hpp"
+#include <algorithm>
+#include <cassert>
+
+geometry_pool::free_list::free_list(GLsizei Capacity)
+{
+	if(Capacity > 0)
+		this->Blocks[0] = Capacity;
+}
+
+GLsizei geometry_pool::free_list::allocate(GLsizei Size)
+{
+	for(std::map<GLsizei, GLsizei>::iterator it = this->Blocks.begin(); it != this->Blocks.end(); ++it)
+	{
+		if(it->second < Size)
+			continue;
+
+		GLsizei const Offset = it->first;
+		GLsizei const Remaining = it->second - Size;
+		this->Blocks.erase(it);
+		if(Remaining > 0)
+			this->Blocks[Offset + Size] = Remaining;
+		return Offset;
+	}
+
+	return -1;
+}
+
+void geometry_pool::free_list::release(GLsizei Offset, GLsizei Size)
+{
+	if(Size <= 0)
+		return;
+
+	std::map<GLsizei, GLsizei>::iterator Next = this->Blocks.lower_bound(Offset);
+	if(Next != this->Blocks.end() && Offset + Size == Next->first)
+	{
+		Size += Next->second;
+		Next = this->Blocks.erase(Next);
+	}
+
+	if(Next != this->Blocks.begin())
+	{
+		std::map<GLsizei, GLsizei>::iterator Prev = Next;
+		--Prev;
+		if(Prev->first + Prev->second == Offset)
+		{
+			Prev->second += Size;
+			return;
+		}
+	}
+
+	this->Blocks[Offset] = Size;
+}
+
+void geometry_pool::free_list::reserve(GLsizei Offset, GLsizei Size)
+{
+	std::map<GLsizei, GLsizei>::iterator it = this->Blocks.upper_bound(Offset);
+	if(it == this->Blocks.begin() || Size <= 0)
+		return;
+	--it;
+
+	GLsizei const BlockOffset = it->first;
+	GLsizei const BlockEnd = it->first + it->second;
+	if(Offset + Size > BlockEnd)
+		return;
+
+	this->Blocks.erase(it);
+	if(Offset > BlockOffset)
+		this->Blocks[BlockOffset] = Offset - BlockOffset;
+	if(BlockEnd > Offset + Size)
+		this->Blocks[Offset + Size] = BlockEnd - (Offset + Size);
+}
+
+geometry_pool::geometry_pool(std::vector<attribute> const& Format, GLsizei Stride, GLsizei VertexCapacity, GLsizei IndexCapacity) :
+	Format(Format),
+	Stride(Stride),
+	VertexCapacity(VertexCapacity),
+	IndexCapacity(IndexCapacity),
+	VertexArrayName(0),
+	VertexBufferName(0),
+	IndexBufferName(0),
+	CopyBufferName(0),
+	CopyBufferSize(0),
+	VertexFreeList(VertexCapacity),
+	IndexFreeList(IndexCapacity),
+	Fragmented(false)
+{}
+
+void geometry_pool::init()
+{
+	glGenBuffers(1, &this->VertexBufferName);
+	glBindBuffer(GL_ARRAY_BUFFER, this->VertexBufferName);
+	glBufferData(GL_ARRAY_BUFFER, this->vertexBufferSize(), NULL, GL_STATIC_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	glGenBuffers(1, &this->IndexBufferName);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, this->IndexBufferName);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, this->indexBufferSize(), NULL, GL_STATIC_DRAW);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+	glGenVertexArrays(1, &this->VertexArrayName);
+	glBindVertexArray(this->VertexArrayName);
+		glBindBuffer(GL_ARRAY_BUFFER, this->VertexBufferName);
+		for(std::size_t i = 0; i < this->Format.size(); ++i)
+		{
+			attribute const& Attribute = this->Format[i];
+			glVertexAttribPointer(Attribute.Location, Attribute.Size, Attribute.Type, Attribute.Normalized, this->Stride, BUFFER_OFFSET(Attribute.Offset));
+			glEnableVertexAttribArray(Attribute.Location);
+		}
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, this->IndexBufferName);
+	glBindVertexArray(0);
+}
+
+void geometry_pool::release()
+{
+	GLuint const BufferName[] = {this->VertexBufferName, this->IndexBufferName, this->CopyBufferName};
+	glDeleteBuffers(3, BufferName);
+	glDeleteVertexArrays(1, &this->VertexArrayName);
+
+	this->VertexArrayName = this->VertexBufferName = this->IndexBufferName = this->CopyBufferName = 0;
+	this->CopyBufferSize = 0;
+}
+
+geometry_pool::handle geometry_pool::allocate(void const* Vertices, GLsizei VertexCount, GLushort const* Indices, GLsizei IndexCount)
+{
+	GLsizei const BaseVertex = this->VertexFreeList.allocate(VertexCount);
+	if(BaseVertex < 0)
+		return INVALID;
+
+	GLsizei const FirstIndex = this->IndexFreeList.allocate(IndexCount);
+	if(FirstIndex < 0)
+	{
+		this->VertexFreeList.release(BaseVertex, VertexCount);
+		return INVALID;
+	}
+
+	glBindBuffer(GL_ARRAY_BUFFER, this->VertexBufferName);
+	glBufferSubData(GL_ARRAY_BUFFER, GLintptr(BaseVertex) * this->Stride, GLsizeiptr(VertexCount) * this->Stride, Vertices);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	// The element array binding is VAO state, use the generic copy target instead
+	glBindBuffer(GL_COPY_WRITE_BUFFER, this->IndexBufferName);
+	glBufferSubData(GL_COPY_WRITE_BUFFER, GLintptr(FirstIndex) * sizeof(GLushort), GLsizeiptr(IndexCount) * sizeof(GLushort), Indices);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+	mesh const Mesh = {BaseVertex, VertexCount, FirstIndex, IndexCount};
+
+	handle Handle = this->Meshes.size();
+	if(this->FreeHandles.empty())
+	{
+		this->Meshes.push_back(Mesh);
+		this->Live.push_back(true);
+	}
+	else
+	{
+		Handle = this->FreeHandles.back();
+		this->FreeHandles.pop_back();
+		this->Meshes[Handle] = Mesh;
+		this->Live[Handle] = true;
+	}
+
+	return Handle;
+}
+
+void geometry_pool::free(handle Handle)
+{
+	if(Handle >= this->Meshes.size() || !this->Live[Handle])
+		return;
+
+	mesh const& Mesh = this->Meshes[Handle];
+	this->VertexFreeList.release(Mesh.BaseVertex, Mesh.VertexCount);
+	this->IndexFreeList.release(GLsizei(Mesh.FirstIndex), Mesh.IndexCount);
+	this->Live[Handle] = false;
+	this->FreeHandles.push_back(Handle);
+	this->Fragmented = true;
+}
+
+geometry_pool::mesh const& geometry_pool::get(handle Handle) const
+{
+	assert(Handle < this->Meshes.size() && this->Live[Handle]);
+	return this->Meshes[Handle];
+}
+
+void geometry_pool::bind() const
+{
+	glBindVertexArray(this->VertexArrayName);
+}
+
+void geometry_pool::draw(handle Handle, GLsizei InstanceCount) const
+{
+	mesh const& Mesh = this->get(Handle);
+	glDrawElementsInstancedBaseVertex(GL_TRIANGLES, Mesh.IndexCount, GL_UNSIGNED_SHORT,
+		BUFFER_OFFSET(Mesh.FirstIndex * sizeof(GLushort)), InstanceCount, Mesh.BaseVertex);
+}
+
+GLuint geometry_pool::vertexBuffer() const
+{
+	return this->VertexBufferName;
+}
+
+GLuint geometry_pool::indexBuffer() const
+{
+	return this->IndexBufferName;
+}
+
+GLsizeiptr geometry_pool::vertexBufferSize() const
+{
+	return GLsizeiptr(this->VertexCapacity) * this->Stride;
+}
+
+GLsizeiptr geometry_pool::indexBufferSize() const
+{
+	return GLsizeiptr(this->IndexCapacity) * GLsizeiptr(sizeof(GLushort));
+}
+
+GLuint geometry_pool::copyBuffer() const
+{
+	return this->CopyBufferName;
+}
+
+GLsizeiptr geometry_pool::copyBufferSize() const
+{
+	return this->CopyBufferSize;
+}
+
+// Source and destination may overlap, go through a scratch buffer as glCopyBufferSubData forbids it
+void geometry_pool::move(GLuint BufferName, GLintptr Source, GLintptr Destination, GLsizeiptr Size)
+{
+	if(this->CopyBufferSize < Size)
+	{
+		if(this->CopyBufferName == 0)
+			glGenBuffers(1, &this->CopyBufferName);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, this->CopyBufferName);
+		glBufferData(GL_COPY_WRITE_BUFFER, Size, NULL, GL_STREAM_COPY);
+		this->CopyBufferSize = Size;
+	}
+
+	glBindBuffer(GL_COPY_READ_BUFFER, BufferName);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, this->CopyBufferName);
+	glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, Source, 0, Size);
+
+	glBindBuffer(GL_COPY_READ_BUFFER, this->CopyBufferName);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, BufferName);
+	glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, Destination, Size);
+
+	glBindBuffer(GL_COPY_READ_BUFFER, 0);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+// Free lists are rebuilt from the live meshes after meshes moved
+void geometry_pool::rebuild()
+{
+	this->VertexFreeList = free_list(this->VertexCapacity);
+	this->IndexFreeList = free_list(this->IndexCapacity);
+
+	for(handle Handle = 0; Handle < this->Meshes.size(); ++Handle)
+	{
+		if(!this->Live[Handle])
+			continue;
+
+		mesh const& Mesh = this->Meshes[Handle];
+		this->VertexFreeList.reserve(Mesh.BaseVertex, Mesh.VertexCount);
+		this->IndexFreeList.reserve(GLsizei(Mesh.FirstIndex), Mesh.IndexCount);
+	}
+}
+
+std::size_t geometry_pool::defragment(std::size_t ByteBudget)
+{
+	if(!this->Fragmented)
+		return 0;
+
+	std::vector<handle> Order;
+	for(handle Handle = 0; Handle < this->Meshes.size(); ++Handle)
+		if(this->Live[Handle])
+			Order.push_back(Handle);
+
+	// The first move of a call ignores the budget, a mesh larger than it would never move otherwise
+	std::size_t Copied(0);
+	bool Budget(true);
+
+	// Walk live meshes in arena order and slide each one down onto the end of the previous one
+	std::sort(Order.begin(), Order.end(), [this](handle A, handle B) { return this->Meshes[A].BaseVertex < this->Meshes[B].BaseVertex; });
+	GLsizei VertexEnd(0);
+	for(std::size_t i = 0; Budget && i < Order.size(); ++i)
+	{
+		mesh& Mesh = this->Meshes[Order[i]];
+		std::size_t const Bytes = std::size_t(Mesh.VertexCount) * this->Stride;
+		if(Mesh.BaseVertex > VertexEnd)
+		{
+			Budget = Copied == 0 || Copied + Bytes <= ByteBudget;
+			if(!Budget)
+				break;
+
+			this->move(this->VertexBufferName, GLintptr(Mesh.BaseVertex) * this->Stride, GLintptr(VertexEnd) * this->Stride, GLsizeiptr(Bytes));
+			Mesh.BaseVertex = VertexEnd;
+			Copied += Bytes;
+		}
+		VertexEnd = Mesh.BaseVertex + Mesh.VertexCount;
+	}
+
+	std::sort(Order.begin(), Order.end(), [this](handle A, handle B) { return this->Meshes[A].FirstIndex < this->Meshes[B].FirstIndex; });
+	GLsizeiptr IndexEnd(0);
+	for(std::size_t i = 0; Budget && i < Order.size(); ++i)
+	{
+		mesh& Mesh = this->Meshes[Order[i]];
+		std::size_t const Bytes = std::size_t(Mesh.IndexCount) * sizeof(GLushort);
+		if(Mesh.FirstIndex > IndexEnd)
+		{
+			Budget = Copied == 0 || Copied + Bytes <= ByteBudget;
+			if(!Budget)
+				break;
+
+			this->move(this->IndexBufferName, Mesh.FirstIndex * GLintptr(sizeof(GLushort)), IndexEnd * GLintptr(sizeof(GLushort)), GLsizeiptr(Bytes));
+			Mesh.FirstIndex = IndexEnd;
+			Copied += Bytes;
+		}
+		IndexEnd = Mesh.FirstIndex + Mesh.IndexCount;
+	}
+
+	if(Copied > 0)
+		this->rebuild();
+	this->Fragmented = !Budget;
+
+	return Copied;
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+#include "test.hpp"
+#include <cstddef>
+#include <map>
+#include <vector>
+
+// Vertex and index arenas shared by every mesh of one vertex format, drawn with one VAO.
+// A mesh is a (BaseVertex, FirstIndex) pair into the arenas, indices are relative to the mesh
+// so the arenas can be compacted by only updating the pair.
+class geometry_pool
+{
+public:
+	struct attribute
+	{
+		GLuint Location;
+		GLint Size;
+		GLenum Type;
+		GLboolean Normalized;
+		GLsizeiptr Offset;
+	};
+
+	struct mesh
+	{
+		GLint BaseVertex;
+		GLsizei VertexCount;
+		GLsizeiptr FirstIndex;
+		GLsizei IndexCount;
+	};
+
+	typedef std::size_t handle;
+	static handle const INVALID = ~handle(0);
+
+	geometry_pool(std::vector<attribute> const& Format, GLsizei Stride, GLsizei VertexCapacity, GLsizei IndexCapacity);
+
+	// Allocates the arenas once with their final size, data is only written with glBufferSubData.
+	// GL errors are left to the caller's checkError.
+	void init();
+	void release();
+
+	handle allocate(void const* Vertices, GLsizei VertexCount, GLushort const* Indices, GLsizei IndexCount);
+	void free(handle Handle);
+
+	mesh const& get(handle Handle) const;
+
+	void bind() const;
+	void draw(handle Handle, GLsizei InstanceCount = 1) const;
+
+	// Names and sizes in bytes of the arenas, fixed by init()
+	GLuint vertexBuffer() const;
+	GLuint indexBuffer() const;
+	GLsizeiptr vertexBufferSize() const;
+	GLsizeiptr indexBufferSize() const;
+
+	// Scratch buffer of defragment(), 0 until the first move, grows to the largest mesh moved
+	GLuint copyBuffer() const;
+	GLsizeiptr copyBufferSize() const;
+
+	// Closes holes by moving meshes toward the start of the arenas, copying at most ByteBudget
+	// bytes per call, meant to be called every frame. A mesh larger than ByteBudget is still moved
+	// on its own, so every call makes progress. Returns the number of bytes copied, 0 once the
+	// arenas are compact.
+	std::size_t defragment(std::size_t ByteBudget);
+
+private:
+	// First fit free list, blocks are coalesced on release
+	class free_list
+	{
+	public:
+		explicit free_list(GLsizei Capacity);
+
+		GLsizei allocate(GLsizei Size);
+		void release(GLsizei Offset, GLsizei Size);
+
+		// Marks a range that is known to be free as used
+		void reserve(GLsizei Offset, GLsizei Size);
+
+	private:
+		std::map<GLsizei, GLsizei> Blocks;
+	};
+
+	void move(GLuint BufferName, GLintptr Source, GLintptr Destination, GLsizeiptr Size);
+	void rebuild();
+
+	std::vector<attribute> Format;
+	GLsizei Stride;
+	GLsizei VertexCapacity;
+	GLsizei IndexCapacity;
+
+	GLuint VertexArrayName;
+	GLuint VertexBufferName;
+	GLuint IndexBufferName;
+	GLuint CopyBufferName;
+	GLsizeiptr CopyBufferSize;
+
+	free_list VertexFreeList;
+	free_list IndexFreeList;
+	std::vector<mesh> Meshes;
+	std::vector<bool> Live;
+	std::vector<handle> FreeHandles;
+	bool Fragmented;
+};
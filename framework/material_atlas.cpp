@@ -0,0 +1,124 @@
+#include "material_atlas.hpp"
+#include <algorithm>
+
+namespace
+{
+	// Bytes per 4x4 block of the S3TC formats, 0 for uncompressed formats
+	GLsizei blockSize(GLenum InternalFormat)
+	{
+		switch(InternalFormat)
+		{
+		case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+		case GL_COMPRESSED_RGBA_S3TC_DXT1_EXT:
+			return 8;
+		case GL_COMPRESSED_RGBA_S3TC_DXT3_EXT:
+		case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+			return 16;
+		default:
+			return 0;
+		}
+	}
+}//namespace
+
+material_atlas::material_atlas() :
+	InternalFormat(GL_NONE),
+	Width(0),
+	Height(0),
+	Levels(0),
+	TextureName(0)
+{}
+
+void material_atlas::init(GLenum InternalFormat, GLsizei Width, GLsizei Height, GLsizei Levels, GLsizei Layers)
+{
+	this->InternalFormat = InternalFormat;
+	this->Width = Width;
+	this->Height = Height;
+	this->Levels = Levels;
+
+	// Hand out the lowest layers first
+	this->FreeLayers.resize(std::size_t(Layers));
+	for(GLsizei i = 0; i < Layers; ++i)
+		this->FreeLayers[std::size_t(i)] = Layers - 1 - i;
+
+	glGenTextures(1, &this->TextureName);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, this->TextureName);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BASE_LEVEL, 0);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, Levels - 1);
+
+	for(GLint Level = 0; Level < Levels; ++Level)
+	{
+		GLsizei const LevelWidth = std::max<GLsizei>(1, Width >> Level);
+		GLsizei const LevelHeight = std::max<GLsizei>(1, Height >> Level);
+		if(this->compressed())
+			glCompressedTexImage3D(GL_TEXTURE_2D_ARRAY, Level, InternalFormat, LevelWidth, LevelHeight, Layers, 0, this->size(Level) * Layers, NULL);
+		else
+			glTexImage3D(GL_TEXTURE_2D_ARRAY, Level, GLint(InternalFormat), LevelWidth, LevelHeight, Layers, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+	}
+	glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+}
+
+void material_atlas::release()
+{
+	glDeleteTextures(1, &this->TextureName);
+
+	this->TextureName = 0;
+	this->FreeLayers.clear();
+}
+
+GLint material_atlas::allocate()
+{
+	if(this->FreeLayers.empty())
+		return -1;
+
+	GLint const Layer = this->FreeLayers.back();
+	this->FreeLayers.pop_back();
+	return Layer;
+}
+
+void material_atlas::free(GLint Layer)
+{
+	this->FreeLayers.push_back(Layer);
+}
+
+void material_atlas::upload(GLint Layer, GLint Level, void const* Data, GLsizei Size)
+{
+	glBindTexture(GL_TEXTURE_2D_ARRAY, this->TextureName);
+	glCompressedTexSubImage3D(GL_TEXTURE_2D_ARRAY, Level, 0, 0, Layer,
+		std::max<GLsizei>(1, this->Width >> Level), std::max<GLsizei>(1, this->Height >> Level), 1,
+		this->InternalFormat, Size, Data);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+}
+
+void material_atlas::upload(GLint Layer, GLint Level, GLenum Format, GLenum Type, void const* Data)
+{
+	glBindTexture(GL_TEXTURE_2D_ARRAY, this->TextureName);
+	glTexSubImage3D(GL_TEXTURE_2D_ARRAY, Level, 0, 0, Layer,
+		std::max<GLsizei>(1, this->Width >> Level), std::max<GLsizei>(1, this->Height >> Level), 1,
+		Format, Type, Data);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+}
+
+bool material_atlas::compressed() const
+{
+	return blockSize(this->InternalFormat) != 0;
+}
+
+GLsizei material_atlas::size(GLint Level) const
+{
+	GLsizei const LevelWidth = std::max<GLsizei>(1, this->Width >> Level);
+	GLsizei const LevelHeight = std::max<GLsizei>(1, this->Height >> Level);
+	if(this->compressed())
+		return ((LevelWidth + 3) / 4) * ((LevelHeight + 3) / 4) * blockSize(this->InternalFormat);
+	return LevelWidth * LevelHeight * 4;
+}
+
+GLuint material_atlas::name() const
+{
+	return this->TextureName;
+}
+
+void material_atlas::bind(GLuint Unit) const
+{
+	glActiveTexture(GL_TEXTURE0 + Unit);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, this->TextureName);
+}
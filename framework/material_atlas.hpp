@@ -0,0 +1,44 @@
+#pragma once
+
+#include "test.hpp"
+#include <vector>
+
+// Textures of the same format, size and mip chain packed as layers of one GL_TEXTURE_2D_ARRAY.
+// Objects select their material with a layer index instead of a texture bind, so differently
+// textured instances can go out in a single instanced draw.
+//
+// This is the GL 3.2 answer to per-object textures. GL_ARB_bindless_texture would let each
+// instance carry its own texture handle instead, but it requires GL 4.0 / GLSL 400 and the
+// samples using the atlas are GL 3.2 core, so the atlas is also what limits materials to one
+// format and size.
+class material_atlas
+{
+public:
+	material_atlas();
+
+	// GL errors are left to the caller's checkError
+	void init(GLenum InternalFormat, GLsizei Width, GLsizei Height, GLsizei Levels, GLsizei Layers);
+	void release();
+
+	// Returns -1 when every layer is in use
+	GLint allocate();
+	void free(GLint Layer);
+
+	// Data of one mip level of one layer, in the internal format for compressed atlases
+	void upload(GLint Layer, GLint Level, void const* Data, GLsizei Size);
+	void upload(GLint Layer, GLint Level, GLenum Format, GLenum Type, void const* Data);
+
+	bool compressed() const;
+	GLsizei size(GLint Level) const;
+
+	GLuint name() const;
+	void bind(GLuint Unit) const;
+
+private:
+	GLenum InternalFormat;
+	GLsizei Width;
+	GLsizei Height;
+	GLsizei Levels;
+	GLuint TextureName;
+	std::vector<GLint> FreeLayers;
+};
@@ -0,0 +1,237 @@
+#include "memory_tracker.hpp"
+#include "options.hpp"
+#include <algorithm>
+#include <cstdio>
+
+#ifndef GL_GPU_MEMORY_INFO_TOTAL_AVAILABLE_MEMORY_NVX
+#	define GL_GPU_MEMORY_INFO_TOTAL_AVAILABLE_MEMORY_NVX 0x9048
+#	define GL_GPU_MEMORY_INFO_CURRENT_AVAILABLE_VIDMEM_NVX 0x9049
+#endif
+#ifndef GL_TEXTURE_FREE_MEMORY_ATI
+#	define GL_TEXTURE_FREE_MEMORY_ATI 0x87FC
+#endif
+
+namespace
+{
+	// Bytes per 4x4 block of the compressed formats, 0 for uncompressed formats
+	std::size_t blockSize(GLenum InternalFormat)
+	{
+		switch(InternalFormat)
+		{
+		case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+		case GL_COMPRESSED_RGBA_S3TC_DXT1_EXT:
+		case GL_COMPRESSED_RED_RGTC1:
+		case GL_COMPRESSED_SIGNED_RED_RGTC1:
+			return 8;
+		case GL_COMPRESSED_RGBA_S3TC_DXT3_EXT:
+		case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+		case GL_COMPRESSED_RG_RGTC2:
+		case GL_COMPRESSED_SIGNED_RG_RGTC2:
+		case GL_COMPRESSED_RGBA_BPTC_UNORM:
+		case GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM:
+		case GL_COMPRESSED_RGB_BPTC_SIGNED_FLOAT:
+		case GL_COMPRESSED_RGB_BPTC_UNSIGNED_FLOAT:
+			return 16;
+		default:
+			return 0;
+		}
+	}
+
+	// Bytes per texel as the hardware stores it, 24 bit formats are padded to 32 bits
+	std::size_t texelSize(GLenum InternalFormat)
+	{
+		switch(InternalFormat)
+		{
+		case GL_R8:
+		case GL_R8I:
+		case GL_R8UI:
+		case GL_STENCIL_INDEX8:
+			return 1;
+		case GL_RG8:
+		case GL_R16:
+		case GL_R16F:
+		case GL_R16I:
+		case GL_R16UI:
+		case GL_DEPTH_COMPONENT16:
+			return 2;
+		case GL_RGB8:
+		case GL_SRGB8:
+		case GL_RGBA8:
+		case GL_SRGB8_ALPHA8:
+		case GL_RGB10_A2:
+		case GL_R11F_G11F_B10F:
+		case GL_RGB9_E5:
+		case GL_RG16:
+		case GL_RG16F:
+		case GL_R32F:
+		case GL_R32I:
+		case GL_R32UI:
+		case GL_DEPTH_COMPONENT24:
+		case GL_DEPTH_COMPONENT32:
+		case GL_DEPTH_COMPONENT32F:
+		case GL_DEPTH24_STENCIL8:
+			return 4;
+		case GL_RGBA16:
+		case GL_RGBA16F:
+		case GL_RG32F:
+		case GL_DEPTH32F_STENCIL8:
+			return 8;
+		case GL_RGB32F:
+		case GL_RGBA32F:
+		case GL_RGBA32I:
+		case GL_RGBA32UI:
+			return 16;
+		default:
+			std::fprintf(stderr, "memory_tracker: unknown internal format 0x%04X, estimated as 4 bytes per texel\n", unsigned(InternalFormat));
+			return 4;
+		}
+	}
+
+	char const* const CategoryName[memory::MAX] =
+	{
+		"vertex",
+		"index",
+		"uniform",
+		"texture",
+		"render_target"
+	};
+}//namespace
+
+memory_tracker::memory_tracker(int argc, char* argv[], std::string const& Owner) :
+	Enabled(false),
+	Owner(Owner),
+	Driver(memory::DRIVER_NONE),
+	LiveTotal(0),
+	PeakTotal(0)
+{
+	if(char const* Value = options::find(argc, argv, "--memory-report"))
+	{
+		this->Enabled = true;
+		this->Output = Value;
+	}
+
+	std::fill(this->Live, this->Live + memory::MAX, std::size_t(0));
+	std::fill(this->Peak, this->Peak + memory::MAX, std::size_t(0));
+}
+
+bool memory_tracker::enabled() const
+{
+	return this->Enabled;
+}
+
+void memory_tracker::setDriverQuery(memory::driver Driver)
+{
+	this->Driver = Driver;
+}
+
+std::size_t memory_tracker::textureSize(GLenum InternalFormat, GLsizei Width, GLsizei Height, GLsizei Layers, GLsizei Levels, GLsizei Samples)
+{
+	std::size_t const Block = blockSize(InternalFormat);
+	std::size_t const Texel = Block ? 0 : texelSize(InternalFormat);
+
+	std::size_t Bytes(0);
+	for(GLsizei Level = 0; Level < std::max<GLsizei>(Levels, 1); ++Level)
+	{
+		std::size_t const LevelWidth = std::size_t(std::max<GLsizei>(1, Width >> Level));
+		std::size_t const LevelHeight = std::size_t(std::max<GLsizei>(1, Height >> Level));
+		Bytes += Block ?
+			(LevelWidth + 3) / 4 * ((LevelHeight + 3) / 4) * Block :
+			LevelWidth * LevelHeight * Texel;
+	}
+
+	return Bytes * std::size_t(std::max<GLsizei>(Layers, 1)) * std::size_t(std::max<GLsizei>(Samples, 1));
+}
+
+void memory_tracker::track(memory::kind Kind, GLuint Name, memory::category Category, std::size_t Bytes)
+{
+	if(Name == 0)
+		return;
+
+	allocation& Allocation = this->Allocations[key(Kind, Name)];
+	this->Live[Allocation.Category] -= Allocation.Bytes;
+	this->LiveTotal -= Allocation.Bytes;
+
+	Allocation.Category = Category;
+	Allocation.Bytes = Bytes;
+	this->Live[Category] += Bytes;
+	this->LiveTotal += Bytes;
+
+	this->Peak[Category] = std::max(this->Peak[Category], this->Live[Category]);
+	this->PeakTotal = std::max(this->PeakTotal, this->LiveTotal);
+}
+
+void memory_tracker::buffer(memory::category Category, GLuint Name, GLsizeiptr Size)
+{
+	this->track(memory::BUFFER, Name, Category, std::size_t(Size));
+}
+
+void memory_tracker::texture(memory::category Category, GLuint Name, GLenum InternalFormat, GLsizei Width, GLsizei Height, GLsizei Layers, GLsizei Levels, GLsizei Samples)
+{
+	this->track(memory::TEXTURE_OBJECT, Name, Category, textureSize(InternalFormat, Width, Height, Layers, Levels, Samples));
+}
+
+void memory_tracker::release(memory::kind Kind, GLsizei Count, GLuint const* Names)
+{
+	for(GLsizei i = 0; i < Count; ++i)
+	{
+		std::map<key, allocation>::iterator it = this->Allocations.find(key(Kind, Names[i]));
+		if(it == this->Allocations.end())
+			continue;
+
+		this->Live[it->second.Category] -= it->second.Bytes;
+		this->LiveTotal -= it->second.Bytes;
+		this->Allocations.erase(it);
+	}
+}
+
+memory_tracker::snapshot memory_tracker::query() const
+{
+	snapshot Snapshot;
+	std::copy(this->Live, this->Live + memory::MAX, Snapshot.Live);
+	std::copy(this->Peak, this->Peak + memory::MAX, Snapshot.Peak);
+	Snapshot.LiveTotal = this->LiveTotal;
+	Snapshot.PeakTotal = this->PeakTotal;
+	Snapshot.ObjectCount = this->Allocations.size();
+	Snapshot.DriverTotal = -1;
+	Snapshot.DriverAvailable = -1;
+
+	if(this->Driver == memory::DRIVER_NVX)
+	{
+		glGetIntegerv(GL_GPU_MEMORY_INFO_TOTAL_AVAILABLE_MEMORY_NVX, &Snapshot.DriverTotal);
+		glGetIntegerv(GL_GPU_MEMORY_INFO_CURRENT_AVAILABLE_VIDMEM_NVX, &Snapshot.DriverAvailable);
+	}
+	else if(this->Driver == memory::DRIVER_ATI)
+	{
+		// Free memory of the texture pool, total free first
+		GLint FreeMemory[4] = {-1, -1, -1, -1};
+		glGetIntegerv(GL_TEXTURE_FREE_MEMORY_ATI, FreeMemory);
+		Snapshot.DriverAvailable = FreeMemory[0];
+	}
+
+	return Snapshot;
+}
+
+bool memory_tracker::save()
+{
+	if(!this->Enabled)
+		return true;
+
+	snapshot const Snapshot = this->query();
+
+	FILE* File = this->Output.empty() ? stdout : std::fopen(this->Output.c_str(), "w");
+	if(!File)
+		return false;
+
+	std::fprintf(File, "{\n\t\"sample\": \"%s\",\n\t\"categories\": {\n", this->Owner.c_str());
+	for(std::size_t i = 0; i < memory::MAX; ++i)
+		std::fprintf(File, "\t\t\"%s\": {\"live_bytes\": %llu, \"peak_bytes\": %llu}%s\n",
+			CategoryName[i], static_cast<unsigned long long>(Snapshot.Live[i]), static_cast<unsigned long long>(Snapshot.Peak[i]), i + 1 < memory::MAX ? "," : "");
+	std::fprintf(File, "\t},\n\t\"live_bytes\": %llu,\n\t\"peak_bytes\": %llu,\n\t\"live_objects\": %u,\n",
+		static_cast<unsigned long long>(Snapshot.LiveTotal), static_cast<unsigned long long>(Snapshot.PeakTotal), unsigned(Snapshot.ObjectCount));
+	std::fprintf(File, "\t\"driver_total_kib\": %d,\n\t\"driver_available_kib\": %d\n}\n", Snapshot.DriverTotal, Snapshot.DriverAvailable);
+
+	if(File != stdout)
+		std::fclose(File);
+
+	return true;
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include "test.hpp"
+#include <cstddef>
+#include <map>
+#include <string>
+#include <utility>
+
+namespace memory
+{
+	enum category
+	{
+		VERTEX,
+		INDEX,
+		UNIFORM,
+		TEXTURE,
+		RENDER_TARGET,
+		MAX
+	};
+
+	// GL names of buffers and textures overlap, the kind is part of the key
+	enum kind
+	{
+		BUFFER,
+		TEXTURE_OBJECT
+	};
+
+	// Extension the driver exposes its own memory counters through
+	enum driver
+	{
+		DRIVER_NONE,
+		DRIVER_NVX,  // GL_NVX_gpu_memory_info
+		DRIVER_ATI   // GL_ATI_meminfo
+	};
+}//namespace memory
+
+// Estimated GPU memory of the objects a sample allocates. The sample reports each allocation
+// next to its glBufferData / glTex*Image* call and each release next to its glDelete* call, the
+// tracker keeps live and peak totals per category. Enabled with --memory-report <file>, stdout
+// when no file is given, the report is written when the sample calls save() at the end of end():
+// peak is what the sample held while running, live what it didn't release.
+class memory_tracker
+{
+public:
+	struct snapshot
+	{
+		std::size_t Live[memory::MAX];
+		std::size_t Peak[memory::MAX];
+		std::size_t LiveTotal;
+		std::size_t PeakTotal;
+		std::size_t ObjectCount;
+		// From GL_NVX_gpu_memory_info or GL_ATI_meminfo in KiB, -1 when neither is exposed
+		GLint DriverTotal;
+		GLint DriverAvailable;
+	};
+
+	memory_tracker(int argc, char* argv[], std::string const& Owner);
+
+	bool enabled() const;
+
+	// Driver counters as checked by the framework, DRIVER_NONE by default
+	void setDriverQuery(memory::driver Driver);
+
+	// Bytes of a 2D, 2D array or multisample texture. Layers don't shrink along the mip chain,
+	// compressed formats are counted in 4x4 blocks. Unknown formats are counted as 4 bytes per
+	// texel with a warning on stderr
+	static std::size_t textureSize(GLenum InternalFormat, GLsizei Width, GLsizei Height, GLsizei Layers, GLsizei Levels, GLsizei Samples);
+
+	// Calling again with the same name replaces the previous allocation, as glBufferData does
+	void buffer(memory::category Category, GLuint Name, GLsizeiptr Size);
+	void texture(memory::category Category, GLuint Name, GLenum InternalFormat, GLsizei Width, GLsizei Height, GLsizei Layers, GLsizei Levels, GLsizei Samples);
+	void release(memory::kind Kind, GLsizei Count, GLuint const* Names);
+
+	snapshot query() const;
+
+	bool save();
+
+private:
+	typedef std::pair<memory::kind, GLuint> key;
+
+	struct allocation
+	{
+		memory::category Category;
+		std::size_t Bytes;
+	};
+
+	void track(memory::kind Kind, GLuint Name, memory::category Category, std::size_t Bytes);
+
+	bool Enabled;
+	std::string Output;
+	std::string Owner;
+	memory::driver Driver;
+	std::map<key, allocation> Allocations;
+	std::size_t Live[memory::MAX];
+	std::size_t Peak[memory::MAX];
+	std::size_t LiveTotal;
+	std::size_t PeakTotal;
+};
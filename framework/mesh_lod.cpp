@@ -0,0 +1,370 @@
+#include "mesh_lod.hpp"
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <map>
+#include <queue>
+
+namespace
+{
+	// Symmetric 4x4 matrix of the sum of squared distances to a set of planes. Face planes have a unit
+	// weight so that the square root of the cost stays in object space units
+	struct quadric
+	{
+		quadric()
+		{
+			std::fill(this->M, this->M + 10, 0.0);
+		}
+
+		void add(double a, double b, double c, double d, double Weight)
+		{
+			double const P[4] = {a, b, c, d};
+			for(int i = 0, k = 0; i < 4; ++i)
+				for(int j = i; j < 4; ++j, ++k)
+					this->M[k] += P[i] * P[j] * Weight;
+		}
+
+		void add(quadric const& Q)
+		{
+			for(int k = 0; k < 10; ++k)
+				this->M[k] += Q.M[k];
+		}
+
+		double evaluate(glm::vec3 const& V) const
+		{
+			double const P[4] = {V.x, V.y, V.z, 1.0};
+			double Result = 0.0;
+			for(int i = 0, k = 0; i < 4; ++i)
+				for(int j = i; j < 4; ++j, ++k)
+					Result += this->M[k] * P[i] * P[j] * (i == j ? 1.0 : 2.0);
+			return std::max(Result, 0.0);
+		}
+
+		double M[10];
+	};
+
+	struct collapse
+	{
+		double Cost;
+		GLushort From;
+		GLushort To;
+		unsigned int Version;
+
+		bool operator>(collapse const& Other) const
+		{
+			return this->Cost > Other.Cost;
+		}
+	};
+
+	GLushort find(std::vector<GLushort>& Remap, GLushort Vertex)
+	{
+		while(Remap[Vertex] != Vertex)
+			Vertex = Remap[Vertex] = Remap[Remap[Vertex]];
+		return Vertex;
+	}
+
+	double const BoundaryWeight(1000.0);
+
+	// Distance from P to the triangle ABC, closest point by Voronoi region of the triangle
+	float distance(glm::vec3 const& P, glm::vec3 const& A, glm::vec3 const& B, glm::vec3 const& C)
+	{
+		glm::vec3 const AB = B - A;
+		glm::vec3 const AC = C - A;
+		glm::vec3 const AP = P - A;
+		float const D1 = glm::dot(AB, AP);
+		float const D2 = glm::dot(AC, AP);
+		if(D1 <= 0.0f && D2 <= 0.0f)
+			return glm::length(P - A);
+
+		glm::vec3 const BP = P - B;
+		float const D3 = glm::dot(AB, BP);
+		float const D4 = glm::dot(AC, BP);
+		if(D3 >= 0.0f && D4 <= D3)
+			return glm::length(P - B);
+
+		float const VC = D1 * D4 - D3 * D2;
+		if(VC <= 0.0f && D1 >= 0.0f && D3 <= 0.0f)
+			return glm::length(P - (A + AB * (D1 / (D1 - D3))));
+
+		glm::vec3 const CP = P - C;
+		float const D5 = glm::dot(AB, CP);
+		float const D6 = glm::dot(AC, CP);
+		if(D6 >= 0.0f && D5 <= D6)
+			return glm::length(P - C);
+
+		float const VB = D5 * D2 - D1 * D6;
+		if(VB <= 0.0f && D2 >= 0.0f && D6 <= 0.0f)
+			return glm::length(P - (A + AC * (D2 / (D2 - D6))));
+
+		float const VA = D3 * D6 - D5 * D4;
+		if(VA <= 0.0f && D4 - D3 >= 0.0f && D5 - D6 >= 0.0f)
+			return glm::length(P - (B + (C - B) * ((D4 - D3) / ((D4 - D3) + (D5 - D6)))));
+
+		float const Denom = 1.0f / (VA + VB + VC);
+		return glm::length(P - (A + AB * (VB * Denom) + AC * (VC * Denom)));
+	}
+}//namespace
+
+namespace lod
+{
+	float simplify(std::vector<glm::vec3> const& Positions, std::vector<GLushort>& Indices, std::size_t TargetCount, float MaxError)
+	{
+		if(Positions.size() > MAX_VERTICES)
+			return -1.0f;
+
+		std::size_t const VertexCount = Positions.size();
+		std::size_t const FaceCount = Indices.size() / 3;
+
+		std::vector<glm::vec3> Normals(FaceCount);
+		std::vector<quadric> Quadrics(VertexCount);
+		std::vector<std::vector<std::size_t> > Faces(VertexCount);
+		for(std::size_t Face = 0; Face < FaceCount; ++Face)
+		{
+			glm::vec3 const& A = Positions[Indices[Face * 3 + 0]];
+			glm::vec3 const Normal = glm::cross(Positions[Indices[Face * 3 + 1]] - A, Positions[Indices[Face * 3 + 2]] - A);
+			float const Area = glm::length(Normal);
+			if(Area <= 0.0f)
+				continue;
+
+			Normals[Face] = Normal / Area;
+			for(std::size_t j = 0; j < 3; ++j)
+			{
+				Quadrics[Indices[Face * 3 + j]].add(Normals[Face].x, Normals[Face].y, Normals[Face].z, -glm::dot(Normals[Face], A), 1.0);
+				Faces[Indices[Face * 3 + j]].push_back(Face);
+			}
+		}
+
+		// Open edges get a heavy plane perpendicular to their face, so that the silhouette of the mesh
+		// stays in place, a flat mesh would otherwise collapse its border at no cost
+		std::map<std::pair<GLushort, GLushort>, std::size_t> Edges;
+		for(std::size_t i = 0; i < FaceCount * 3; ++i)
+		{
+			GLushort const A = Indices[i];
+			GLushort const B = Indices[i - i % 3 + (i + 1) % 3];
+			++Edges[std::make_pair(std::min(A, B), std::max(A, B))];
+		}
+		for(std::size_t i = 0; i < FaceCount * 3; ++i)
+		{
+			GLushort const A = Indices[i];
+			GLushort const B = Indices[i - i % 3 + (i + 1) % 3];
+			if(Edges[std::make_pair(std::min(A, B), std::max(A, B))] != 1)
+				continue;
+
+			glm::vec3 const Edge = Positions[B] - Positions[A];
+			glm::vec3 const Side = glm::cross(Edge, Normals[i / 3]);
+			float const Length = glm::length(Side);
+			if(Length <= 0.0f)
+				continue;
+
+			glm::vec3 const N = Side / Length;
+			Quadrics[A].add(N.x, N.y, N.z, -glm::dot(N, Positions[A]), BoundaryWeight);
+			Quadrics[B].add(N.x, N.y, N.z, -glm::dot(N, Positions[A]), BoundaryWeight);
+		}
+
+		// A vertex version changes every time one of its edges collapses, older queue entries are stale
+		std::vector<unsigned int> Version(VertexCount, 0);
+		std::vector<GLushort> Remap(VertexCount);
+		for(std::size_t i = 0; i < VertexCount; ++i)
+			Remap[i] = GLushort(i);
+
+		std::priority_queue<collapse, std::vector<collapse>, std::greater<collapse> > Queue;
+		auto Push = [&](GLushort A, GLushort B)
+		{
+			quadric Q = Quadrics[A];
+			Q.add(Quadrics[B]);
+			double const CostA = Q.evaluate(Positions[A]);
+			double const CostB = Q.evaluate(Positions[B]);
+			collapse const Collapse = CostB <= CostA ?
+				collapse{CostB, A, B, Version[A] + Version[B]} :
+				collapse{CostA, B, A, Version[A] + Version[B]};
+			Queue.push(Collapse);
+		};
+
+		for(std::map<std::pair<GLushort, GLushort>, std::size_t>::const_iterator it = Edges.begin(); it != Edges.end(); ++it)
+			Push(it->first.first, it->first.second);
+
+		// Moving From onto To must not fold any of the faces that survive the collapse
+		auto Flips = [&](GLushort From, GLushort To)
+		{
+			for(std::size_t f = 0; f < Faces[From].size(); ++f)
+			{
+				std::size_t const Face = Faces[From][f];
+				GLushort Corner[3];
+				bool Degenerate = false;
+				for(std::size_t j = 0; j < 3; ++j)
+				{
+					Corner[j] = find(Remap, Indices[Face * 3 + j]);
+					Degenerate = Degenerate || Corner[j] == To;
+					if(Corner[j] == From)
+						Corner[j] = To;
+				}
+				if(Degenerate || Corner[0] == Corner[1] || Corner[1] == Corner[2] || Corner[2] == Corner[0])
+					continue;
+
+				glm::vec3 const Normal = glm::cross(Positions[Corner[1]] - Positions[Corner[0]], Positions[Corner[2]] - Positions[Corner[0]]);
+				if(glm::dot(Normal, Normals[Face]) <= 0.0f)
+					return true;
+			}
+			return false;
+		};
+
+		std::vector<bool> Removed(FaceCount, false);
+		std::size_t Triangles = FaceCount;
+		double const MaxCost = double(MaxError) * double(MaxError);
+
+		while(!Queue.empty() && Triangles * 3 > TargetCount)
+		{
+			collapse const Collapse = Queue.top();
+			Queue.pop();
+
+			GLushort const From = find(Remap, Collapse.From);
+			GLushort const To = find(Remap, Collapse.To);
+			if(From != Collapse.From || To != Collapse.To || From == To || Version[From] + Version[To] != Collapse.Version)
+				continue;
+			if(Collapse.Cost > MaxCost)
+				break;
+			if(Flips(From, To))
+				continue;
+
+			Remap[From] = To;
+			Quadrics[To].add(Quadrics[From]);
+			++Version[To];
+
+			// Faces of From now belong to To, the ones that reference both become degenerate
+			for(std::size_t f = 0; f < Faces[From].size(); ++f)
+			{
+				std::size_t const Face = Faces[From][f];
+				if(Removed[Face])
+					continue;
+
+				GLushort const A = find(Remap, Indices[Face * 3 + 0]);
+				GLushort const B = find(Remap, Indices[Face * 3 + 1]);
+				GLushort const C = find(Remap, Indices[Face * 3 + 2]);
+				if(A == B || B == C || C == A)
+				{
+					Removed[Face] = true;
+					--Triangles;
+				}
+				else
+					Faces[To].push_back(Face);
+			}
+			Faces[From].clear();
+
+			// Refresh the collapse candidates around the merged vertex
+			for(std::size_t f = 0; f < Faces[To].size(); ++f)
+			{
+				std::size_t const Face = Faces[To][f];
+				if(Removed[Face])
+					continue;
+				for(std::size_t j = 0; j < 3; ++j)
+				{
+					GLushort const Other = find(Remap, Indices[Face * 3 + j]);
+					if(Other != To)
+						Push(std::min(To, Other), std::max(To, Other));
+				}
+			}
+		}
+
+		// Every collapsed vertex ends on the fan of the vertex it merged into, its distance to that
+		// fan estimates how far the simplified surface moved away from it. Only an estimate: the
+		// closest point of the simplified surface may be elsewhere, and the surface between input
+		// vertices isn't measured at all
+		float Error = 0.0f;
+		for(std::size_t Vertex = 0; Vertex < VertexCount; ++Vertex)
+		{
+			GLushort const To = find(Remap, GLushort(Vertex));
+			if(To == Vertex)
+				continue;
+
+			float Distance = glm::length(Positions[Vertex] - Positions[To]);
+			for(std::size_t f = 0; f < Faces[To].size(); ++f)
+			{
+				std::size_t const Face = Faces[To][f];
+				if(Removed[Face])
+					continue;
+
+				Distance = std::min(Distance, distance(Positions[Vertex],
+					Positions[find(Remap, Indices[Face * 3 + 0])],
+					Positions[find(Remap, Indices[Face * 3 + 1])],
+					Positions[find(Remap, Indices[Face * 3 + 2])]));
+			}
+			Error = std::max(Error, Distance);
+		}
+
+		std::vector<GLushort> Result;
+		Result.reserve(Triangles * 3);
+		for(std::size_t Face = 0; Face < FaceCount; ++Face)
+			if(!Removed[Face])
+				for(std::size_t j = 0; j < 3; ++j)
+					Result.push_back(find(Remap, Indices[Face * 3 + j]));
+		Indices.swap(Result);
+
+		return Error;
+	}
+
+	chain build(std::vector<glm::vec3> const& Positions, GLushort const* Indices, std::size_t IndexCount, std::size_t LevelCount, float Ratio)
+	{
+		chain Chain;
+		if(Positions.size() > MAX_VERTICES || IndexCount == 0)
+			return Chain;
+
+		glm::vec3 Min(std::numeric_limits<float>::max());
+		glm::vec3 Max(-std::numeric_limits<float>::max());
+		for(std::size_t i = 0; i < Positions.size(); ++i)
+			for(int c = 0; c < 3; ++c)
+			{
+				Min[c] = std::min(Min[c], Positions[i][c]);
+				Max[c] = std::max(Max[c], Positions[i][c]);
+			}
+		Chain.Center = (Min + Max) * 0.5f;
+		Chain.Radius = glm::length(Max - Min) * 0.5f;
+
+		std::size_t Previous = IndexCount + 1;
+		float Triangles = float(IndexCount / 3);
+		for(std::size_t Level = 0; Level < LevelCount; ++Level, Triangles *= Ratio)
+		{
+			// Simplifying the source each time keeps the error relative to the source mesh, a level
+			// built from the previous one would only know its distance to the previous level
+			std::vector<GLushort> Current(Indices, Indices + IndexCount);
+			float Error = 0.0f;
+			if(Level > 0)
+				Error = simplify(Positions, Current, std::size_t(Triangles) * 3, std::numeric_limits<float>::max());
+			if(Current.size() >= Previous || Current.empty())
+				break;
+			Previous = Current.size();
+
+			level LevelInfo;
+			LevelInfo.First = GLsizei(Chain.Indices.size());
+			LevelInfo.Count = GLsizei(Current.size());
+			LevelInfo.Start = *std::min_element(Current.begin(), Current.end());
+			LevelInfo.End = *std::max_element(Current.begin(), Current.end());
+			LevelInfo.Error = Error;
+			Chain.Levels.push_back(LevelInfo);
+			Chain.Indices.insert(Chain.Indices.end(), Current.begin(), Current.end());
+		}
+
+		return Chain;
+	}
+
+	std::size_t select(chain const& Chain, glm::mat4 const& MVP, float ViewportHeight, float PixelError)
+	{
+		if(Chain.Levels.empty())
+			return 0;
+
+		// Depth of the sphere center, and the object to clip space scale taken from the y row
+		glm::vec4 const Clip = MVP * glm::vec4(Chain.Center, 1.0f);
+		float const Scale = glm::length(glm::vec3(MVP[0][1], MVP[1][1], MVP[2][1]));
+		float const Distance = Clip.w - Chain.Radius * Scale;
+		if(Distance <= 0.0f)
+			return 0;
+
+		float const PixelsPerUnit = Scale / Distance * ViewportHeight * 0.5f;
+
+		std::size_t Selected = 0;
+		for(std::size_t Level = 1; Level < Chain.Levels.size(); ++Level)
+			if(Chain.Levels[Level].Error * PixelsPerUnit < PixelError)
+				Selected = Level;
+		return Selected;
+	}
+}//namespace lod
@@ -0,0 +1,47 @@
+#pragma once
+
+#include "test.hpp"
+#include <cstddef>
+#include <vector>
+
+// Index only levels of detail: every LOD reuses the vertices of the source mesh, only the index
+// buffer is simplified, so all the levels share one vertex buffer and one VAO.
+namespace lod
+{
+	struct level
+	{
+		GLsizei First;       // First index in lod::chain::Indices
+		GLsizei Count;       // Index count
+		GLushort Start;      // Smallest vertex referenced, [Start, End] for glDrawRangeElements
+		GLushort End;        // Largest vertex referenced
+		float Error;         // Estimated object space error of the level, see simplify()
+	};
+
+	struct chain
+	{
+		std::vector<GLushort> Indices;
+		std::vector<level> Levels;
+		glm::vec3 Center;    // Bounding sphere of the source mesh
+		float Radius;
+	};
+
+	// Indices are GLushort, larger meshes are rejected
+	std::size_t const MAX_VERTICES = 65535;
+
+	// Quadric error edge collapse toward an existing vertex until TargetCount indices remain or
+	// the next collapse costs more than MaxError. Returns an estimate of the error: the largest
+	// distance from a collapsed vertex to the remaining triangles around the vertex it merged into.
+	// It is not a bound on the surface error: only input vertices are measured, and only against
+	// that fan, not against the closest part of the simplified surface. Returns a negative value with Indices
+	// untouched when the mesh has more than MAX_VERTICES vertices.
+	float simplify(std::vector<glm::vec3> const& Positions, std::vector<GLushort>& Indices, std::size_t TargetCount, float MaxError);
+
+	// Level n keeps about Ratio^n of the source triangles and is simplified from the source mesh,
+	// so its error is measured against the source. Stops early when a level doesn't shrink anymore,
+	// returns an empty chain for meshes with more than MAX_VERTICES vertices.
+	chain build(std::vector<glm::vec3> const& Positions, GLushort const* Indices, std::size_t IndexCount, std::size_t LevelCount, float Ratio = 0.5f);
+
+	// Coarsest level whose estimated error projects to less than PixelError pixels under the MVP of
+	// one instance. The estimate can be low, pick PixelError with some margin
+	std::size_t select(chain const& Chain, glm::mat4 const& MVP, float ViewportHeight, float PixelError = 1.0f);
+}//namespace lod
@@ -0,0 +1,20 @@
+#include "options.hpp"
+#include <cstdlib>
+#include <cstring>
+
+namespace options
+{
+	char const* find(int argc, char* argv[], char const* Name)
+	{
+		for(int i = 1; i < argc; ++i)
+			if(std::strcmp(argv[i], Name) == 0)
+				return i + 1 < argc && std::strncmp(argv[i + 1], "--", 2) != 0 ? argv[i + 1] : "";
+		return nullptr;
+	}
+
+	std::size_t count(int argc, char* argv[], char const* Name, std::size_t Default)
+	{
+		char const* Value = find(argc, argv, Name);
+		return Value && *Value ? std::size_t(std::strtoul(Value, nullptr, 10)) : Default;
+	}
+}//namespace options
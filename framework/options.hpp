@@ -0,0 +1,14 @@
+#pragma once
+
+#include <cstddef>
+
+// Command line options of the framework tools, "--name value" pairs and "--name" switches
+namespace options
+{
+	// Value following Name, "" when Name is the last argument or followed by another --option,
+	// null when Name is missing
+	char const* find(int argc, char* argv[], char const* Name);
+
+	// Unsigned value of Name, Default when Name is missing or has no value
+	std::size_t count(int argc, char* argv[], char const* Name, std::size_t Default);
+}//namespace options
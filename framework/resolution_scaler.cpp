@@ -0,0 +1,183 @@
+#include "resolution_scaler.hpp"
+#include "options.hpp"
+#include <algorithm>
+#include <cstdlib>
+
+namespace
+{
+	float const SCALES[] = {1.0f, 0.875f, 0.75f, 0.625f, 0.5f};
+
+	// Weight of the newest pass time in the moving average
+	double const SMOOTHING(0.1);
+	// Step up only when the next level is predicted to stay under this fraction of the budget
+	double const HEADROOM(0.85);
+	// Frames ignored after a change, the queries of older frames are still in flight
+	std::size_t const COOLDOWN(16);
+}//namespace
+
+resolution_scaler::resolution_scaler(int argc, char* argv[], GLsizei MaxSamples) :
+	Enabled(false),
+	Budget(0.0),
+	Current(0),
+	Frame(0),
+	TimerQuery(false),
+	PassTime(-1.0),
+	Cooldown(0)
+{
+	if(char const* Value = options::find(argc, argv, "--dynamic-resolution"))
+	{
+		this->Budget = std::atof(Value);
+		this->Enabled = this->Budget > 0.0;
+	}
+
+	for(std::size_t i = 0; i < sizeof(SCALES) / sizeof(SCALES[0]); ++i)
+	{
+		level const Level = {SCALES[i], MaxSamples};
+		this->Ladder.push_back(Level);
+	}
+
+	if(this->Enabled && options::find(argc, argv, "--dynamic-resolution-samples"))
+		for(GLsizei Samples = MaxSamples / 2; Samples >= 1; Samples /= 2)
+		{
+			level const Level = {SCALES[sizeof(SCALES) / sizeof(SCALES[0]) - 1], Samples};
+			this->Ladder.push_back(Level);
+		}
+
+	std::fill(this->QueryName, this->QueryName + QUERY_LATENCY * 2, 0);
+	std::fill(this->QueryPending, this->QueryPending + QUERY_LATENCY, false);
+}
+
+bool resolution_scaler::enabled() const
+{
+	return this->Enabled;
+}
+
+void resolution_scaler::setTimerQuery(bool Supported)
+{
+	this->TimerQuery = Supported;
+}
+
+std::vector<GLsizei> resolution_scaler::samples() const
+{
+	std::vector<GLsizei> Samples;
+	for(std::size_t i = 0; i < this->Ladder.size(); ++i)
+		if(std::find(Samples.begin(), Samples.end(), this->Ladder[i].Samples) == Samples.end())
+			Samples.push_back(this->Ladder[i].Samples);
+	return Samples;
+}
+
+double resolution_scaler::cost(level const& Level)
+{
+	return double(Level.Scale) * double(Level.Scale) * double(Level.Samples);
+}
+
+void resolution_scaler::begin()
+{
+	if(!this->Enabled)
+		return;
+
+	if(this->Frame == 0 && this->TimerQuery)
+		glGenQueries(QUERY_LATENCY * 2, this->QueryName);
+
+	std::size_t const Slot = this->Frame % QUERY_LATENCY;
+	if(this->TimerQuery && !this->QueryPending[Slot])
+		glQueryCounter(this->QueryName[Slot * 2 + 0], GL_TIMESTAMP);
+}
+
+void resolution_scaler::end()
+{
+	if(!this->Enabled)
+		return;
+
+	// A slot still pending was skipped by begin(), the GPU is more than QUERY_LATENCY frames behind
+	std::size_t const Slot = this->Frame % QUERY_LATENCY;
+	if(this->TimerQuery && !this->QueryPending[Slot])
+	{
+		glQueryCounter(this->QueryName[Slot * 2 + 1], GL_TIMESTAMP);
+		this->QueryPending[Slot] = true;
+	}
+
+	++this->Frame;
+}
+
+bool resolution_scaler::update()
+{
+	if(!this->Enabled || !this->TimerQuery)
+		return false;
+
+	// Oldest slot first, the moving average follows submission order
+	for(std::size_t i = 0; i < QUERY_LATENCY; ++i)
+	{
+		std::size_t const Slot = (this->Frame + i) % QUERY_LATENCY;
+		if(!this->QueryPending[Slot])
+			continue;
+
+		GLint Available(GL_FALSE);
+		glGetQueryObjectiv(this->QueryName[Slot * 2 + 1], GL_QUERY_RESULT_AVAILABLE, &Available);
+		if(Available == GL_FALSE)
+			break;
+
+		GLuint64 Start(0), End(0);
+		glGetQueryObjectui64v(this->QueryName[Slot * 2 + 0], GL_QUERY_RESULT, &Start);
+		glGetQueryObjectui64v(this->QueryName[Slot * 2 + 1], GL_QUERY_RESULT, &End);
+		this->QueryPending[Slot] = false;
+
+		if(this->Cooldown > 0)
+		{
+			--this->Cooldown;
+			continue;
+		}
+
+		double const Time = End > Start ? double(End - Start) * 1e-6 : 0.0;
+		this->PassTime = this->PassTime < 0.0 ? Time : this->PassTime + (Time - this->PassTime) * SMOOTHING;
+	}
+
+	if(this->PassTime < 0.0 || this->Cooldown > 0)
+		return false;
+
+	std::size_t Next = this->Current;
+	if(this->PassTime > this->Budget && this->Current + 1 < this->Ladder.size())
+		Next = this->Current + 1;
+	else if(this->Current > 0)
+	{
+		double const Predicted = this->PassTime * cost(this->Ladder[this->Current - 1]) / cost(this->Ladder[this->Current]);
+		if(Predicted < this->Budget * HEADROOM)
+			Next = this->Current - 1;
+	}
+
+	if(Next == this->Current)
+		return false;
+
+	// Start the average over at the new level, scaled by the predicted cost
+	this->PassTime *= cost(this->Ladder[Next]) / cost(this->Ladder[this->Current]);
+	this->Current = Next;
+	this->Cooldown = COOLDOWN;
+	return true;
+}
+
+resolution_scaler::level const& resolution_scaler::current() const
+{
+	return this->Ladder[this->Current];
+}
+
+glm::ivec2 resolution_scaler::size(glm::ivec2 const& WindowSize) const
+{
+	float const Scale = this->Ladder[this->Current].Scale;
+	return glm::ivec2(
+		std::max(1, int(float(WindowSize.x) * Scale)),
+		std::max(1, int(float(WindowSize.y) * Scale)));
+}
+
+double resolution_scaler::passTime() const
+{
+	return this->PassTime;
+}
+
+void resolution_scaler::release()
+{
+	if(this->TimerQuery)
+	{
+		glDeleteQueries(QUERY_LATENCY * 2, this->QueryName);
+		this->TimerQuery = false;
+	}
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include "test.hpp"
+#include <cstddef>
+#include <vector>
+
+// Holds the GPU time of one offscreen pass under a budget by walking a ladder of render scales,
+// and optionally sample counts, one step at a time.
+// --dynamic-resolution <ms>        budget of the pass, disabled when missing
+// --dynamic-resolution-samples     lower the sample count once the smallest scale is reached
+//
+// The render target is allocated once at full size for every sample count of the ladder, a
+// lower scale only shrinks the viewport, so a step never reallocates anything.
+class resolution_scaler
+{
+public:
+	struct level
+	{
+		float Scale;
+		GLsizei Samples;
+	};
+
+	resolution_scaler(int argc, char* argv[], GLsizei MaxSamples);
+
+	bool enabled() const;
+
+	// GL_ARB_timer_query as checked by the framework, without it the ladder stays at full size
+	void setTimerQuery(bool Supported);
+
+	// Sample counts that may be used, largest first, allocate one render target for each
+	std::vector<GLsizei> samples() const;
+
+	// Brackets the scaled pass with GL_TIMESTAMP queries, they nest in a GL_TIME_ELAPSED query
+	void begin();
+	void end();
+
+	// Reads the finished queries without stalling and moves one step when needed. Returns true
+	// when the level changed
+	bool update();
+
+	level const& current() const;
+	glm::ivec2 size(glm::ivec2 const& WindowSize) const;
+
+	// Smoothed GPU time of the pass in milliseconds, negative until the first result
+	double passTime() const;
+
+	void release();
+
+private:
+	enum
+	{
+		QUERY_LATENCY = 4
+	};
+
+	// Relative cost of a level, proportional to the number of samples shaded
+	static double cost(level const& Level);
+
+	bool Enabled;
+	double Budget;
+	std::vector<level> Ladder;
+	std::size_t Current;
+
+	std::size_t Frame;
+	GLuint QueryName[QUERY_LATENCY * 2];
+	bool QueryPending[QUERY_LATENCY];
+	bool TimerQuery;
+
+	double PassTime;
+	// Results of passes rendered before the last change are skipped
+	std::size_t Cooldown;
+};
@@ -0,0 +1,50 @@
+#include "shader_loader.hpp"
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace
+{
+	// The shader is flagged for deletion once attached, the program owns it
+	bool compile(GLuint ProgramName, GLenum Type, char const* Source, GLchar const* String, GLint Length)
+	{
+		GLuint const ShaderName = glCreateShader(Type);
+		glShaderSource(ShaderName, 1, &String, &Length);
+		glCompileShader(ShaderName);
+
+		GLint Status(GL_FALSE);
+		glGetShaderiv(ShaderName, GL_COMPILE_STATUS, &Status);
+		if(Status != GL_TRUE)
+		{
+			GLint LogLength(0);
+			glGetShaderiv(ShaderName, GL_INFO_LOG_LENGTH, &LogLength);
+			std::vector<char> Log(std::size_t(glm::max(LogLength, 1)), '\0');
+			glGetShaderInfoLog(ShaderName, GLsizei(Log.size()), NULL, &Log[0]);
+			std::fprintf(stderr, "%s:\n%s\n", Source, &Log[0]);
+		}
+
+		glAttachShader(ProgramName, ShaderName);
+		glDeleteShader(ShaderName);
+
+		return Status == GL_TRUE;
+	}
+}//namespace
+
+bool attachShader(pack::reader const& Pack, compiler& Compiler, GLuint ProgramName, GLenum Type, char const* Source, char const* Arguments)
+{
+	void const* Mapped(nullptr);
+	std::size_t MappedSize(0);
+	if(Pack.find(Source, Mapped, MappedSize))
+		return compile(ProgramName, Type, Source, static_cast<GLchar const*>(Mapped), GLint(MappedSize));
+
+	std::vector<char> Data;
+	if(Pack.load(Source, Data))
+		return compile(ProgramName, Type, Source, Data.empty() ? "" : &Data[0], GLint(Data.size()));
+
+	GLuint const ShaderName = Compiler.create(Type, getDataDirectory() + Source, Arguments);
+	if(ShaderName == 0)
+		return false;
+
+	glAttachShader(ProgramName, ShaderName);
+	return true;
+}
@@ -0,0 +1,12 @@
+#pragma once
+
+#include "test.hpp"
+#include "asset_pack.hpp"
+
+// Compile a shader from the asset pack, falling back to the loose file when the pack doesn't have it,
+// and attach it to the program. Packed sources are compiled straight from the mapped pack, or from
+// memory when compressed, without touching the file system; they carry their own #version line and
+// compile errors are reported on stderr. Loose files go through the compiler with Arguments, as before,
+// and compiler::check() reports them.
+bool attachShader(pack::reader const& Pack, compiler& Compiler, GLuint ProgramName, GLenum Type, char const* Source,
+	char const* Arguments = "--version 150 --profile core");
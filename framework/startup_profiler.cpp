@@ -0,0 +1,212 @@
+#include "startup_profiler.hpp"
+#include "options.hpp"
+#include <cstdio>
+#include <cstring>
+
+#if defined(_WIN32)
+#	include <windows.h>
+#	include <psapi.h>
+#else
+#	include <sys/resource.h>
+#endif
+
+startup_profiler::phase::phase(startup_profiler& Profiler, char const* Name) :
+	Profiler(Profiler)
+{
+	this->Profiler.begin(Name);
+}
+
+startup_profiler::phase::~phase()
+{
+	this->Profiler.end();
+}
+
+startup_profiler::clock_start& startup_profiler::shared()
+{
+	static clock_start Shared = {clock::time_point(), false, 0};
+	return Shared;
+}
+
+char const* startup_profiler::start(char const* Title)
+{
+	shared().Start = clock::now();
+	shared().Pending = true;
+	return Title;
+}
+
+startup_profiler::startup_profiler(int argc, char* argv[]) :
+	Cold(shared().Runs == 0),
+	Start(shared().Pending ? shared().Start : clock::now()),
+	PhaseCPUStart(0.0),
+	FirstFrameTime(-1.0),
+	FirstFrameQuery(0),
+	TimerQuery(false)
+{
+	shared().Pending = false;
+	++shared().Runs;
+
+	if(char const* Value = options::find(argc, argv, "--startup-profile"))
+		this->Filename = Value;
+	if(char const* Value = options::find(argc, argv, "--startup-run"))
+		this->Cold = std::strcmp(Value, "warm") != 0;
+}
+
+bool startup_profiler::enabled() const
+{
+	return !this->Filename.empty();
+}
+
+void startup_profiler::setTimerQuery(bool Supported)
+{
+	this->TimerQuery = Supported;
+}
+
+double startup_profiler::cpuTime()
+{
+#	if defined(_WIN32)
+		FILETIME Creation, Exit, Kernel, User;
+		GetProcessTimes(GetCurrentProcess(), &Creation, &Exit, &Kernel, &User);
+		ULARGE_INTEGER KernelTime, UserTime;
+		KernelTime.LowPart = Kernel.dwLowDateTime;
+		KernelTime.HighPart = Kernel.dwHighDateTime;
+		UserTime.LowPart = User.dwLowDateTime;
+		UserTime.HighPart = User.dwHighDateTime;
+		return double(KernelTime.QuadPart + UserTime.QuadPart) * 1e-4;
+#	else
+		rusage Usage;
+		getrusage(RUSAGE_SELF, &Usage);
+		return (Usage.ru_utime.tv_sec + Usage.ru_stime.tv_sec) * 1e3 + (Usage.ru_utime.tv_usec + Usage.ru_stime.tv_usec) * 1e-3;
+#	endif
+}
+
+std::size_t startup_profiler::peakResidentBytes()
+{
+#	if defined(_WIN32)
+		PROCESS_MEMORY_COUNTERS Counters;
+		if(!GetProcessMemoryInfo(GetCurrentProcess(), &Counters, sizeof(Counters)))
+			return 0;
+		return Counters.PeakWorkingSetSize;
+#	else
+		rusage Usage;
+		getrusage(RUSAGE_SELF, &Usage);
+#		if defined(__APPLE__)
+			return std::size_t(Usage.ru_maxrss);
+#		else
+			return std::size_t(Usage.ru_maxrss) * 1024;
+#		endif
+#	endif
+}
+
+// Timestamp queries are resolved in save() so the init phases never wait on the GPU
+GLuint startup_profiler::timestamp()
+{
+	if(!this->TimerQuery)
+		return 0;
+
+	GLuint QueryName(0);
+	glGenQueries(1, &QueryName);
+	glQueryCounter(QueryName, GL_TIMESTAMP);
+	this->Queries.push_back(QueryName);
+
+	return QueryName;
+}
+
+void startup_profiler::begin(char const* Name)
+{
+	if(!this->enabled())
+		return;
+
+	record Record;
+	Record.Name = Name;
+	Record.WallTime = 0.0;
+	Record.CPUTime = 0.0;
+	Record.GPUTime = -1.0;
+	Record.PeakResidentStart = peakResidentBytes();
+	Record.PeakResidentBytes = Record.PeakResidentStart;
+	Record.UploadBytes = 0;
+	Record.Query[0] = this->timestamp();
+	Record.Query[1] = 0;
+	this->Records.push_back(Record);
+
+	this->PhaseStart = clock::now();
+	this->PhaseCPUStart = cpuTime();
+}
+
+void startup_profiler::end()
+{
+	if(!this->enabled() || this->Records.empty())
+		return;
+
+	record& Record = this->Records.back();
+	Record.WallTime = std::chrono::duration<double, std::milli>(clock::now() - this->PhaseStart).count();
+	Record.CPUTime = cpuTime() - this->PhaseCPUStart;
+	Record.PeakResidentBytes = peakResidentBytes();
+	Record.Query[1] = this->timestamp();
+}
+
+void startup_profiler::upload(std::size_t Bytes)
+{
+	if(this->enabled() && !this->Records.empty())
+		this->Records.back().UploadBytes += Bytes;
+}
+
+void startup_profiler::frame()
+{
+	if(!this->enabled() || this->FirstFrameTime >= 0.0)
+		return;
+
+	this->FirstFrameTime = std::chrono::duration<double, std::milli>(clock::now() - this->Start).count();
+	this->FirstFrameQuery = this->timestamp();
+}
+
+bool startup_profiler::save(std::string const& Title)
+{
+	if(!this->enabled())
+		return true;
+
+	FILE* File = std::fopen(this->Filename.c_str(), "w");
+	if(!File)
+		return false;
+
+	GLuint64 FirstTimestamp(0);
+	if(!this->Records.empty() && this->Records[0].Query[0])
+		glGetQueryObjectui64v(this->Records[0].Query[0], GL_QUERY_RESULT, &FirstTimestamp);
+
+	std::fprintf(File, "{\n\t\"sample\": \"%s\",\n\t\"run\": \"%s\",\n\t\"run_note\": \"cold is the first run in this process, not a cold OS file cache\",\n\t\"phases\": [\n",
+		Title.c_str(), this->Cold ? "cold" : "warm");
+	for(std::size_t i = 0; i < this->Records.size(); ++i)
+	{
+		record& Record = this->Records[i];
+		if(Record.Query[0] && Record.Query[1])
+		{
+			GLuint64 Begin(0), End(0);
+			glGetQueryObjectui64v(Record.Query[0], GL_QUERY_RESULT, &Begin);
+			glGetQueryObjectui64v(Record.Query[1], GL_QUERY_RESULT, &End);
+			Record.GPUTime = double(End - Begin) * 1e-6;
+		}
+
+		// ru_maxrss is process wide, the growth of the high-water mark is what this phase added to it
+		std::fprintf(File, "\t\t{\"name\": \"%s\", \"wall_ms\": %.3f, \"cpu_ms\": %.3f, \"gpu_ms\": %.3f, \"cumulative_peak_rss_bytes\": %llu, \"peak_rss_growth_bytes\": %llu, \"upload_bytes\": %llu}%s\n",
+			Record.Name.c_str(), Record.WallTime, Record.CPUTime, Record.GPUTime,
+			static_cast<unsigned long long>(Record.PeakResidentBytes), static_cast<unsigned long long>(Record.PeakResidentBytes - Record.PeakResidentStart),
+			static_cast<unsigned long long>(Record.UploadBytes),
+			i + 1 < this->Records.size() ? "," : "");
+	}
+
+	double FirstFrameGPUTime(-1.0);
+	if(this->FirstFrameQuery && FirstTimestamp)
+	{
+		GLuint64 End(0);
+		glGetQueryObjectui64v(this->FirstFrameQuery, GL_QUERY_RESULT, &End);
+		FirstFrameGPUTime = double(End - FirstTimestamp) * 1e-6;
+	}
+
+	std::fprintf(File, "\t],\n\t\"first_frame_ms\": %.3f,\n\t\"first_frame_gpu_ms\": %.3f,\n\t\"cumulative_peak_rss_bytes\": %llu\n}\n",
+		this->FirstFrameTime, FirstFrameGPUTime, static_cast<unsigned long long>(peakResidentBytes()));
+
+	if(!this->Queries.empty())
+		glDeleteQueries(GLsizei(this->Queries.size()), &this->Queries[0]);
+	this->Queries.clear();
+
+	return std::fclose(File) == 0;
+}
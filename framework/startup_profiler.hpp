@@ -0,0 +1,94 @@
+#pragma once
+
+#include "test.hpp"
+#include <chrono>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// Time to first frame broken down per init phase. Enabled with --startup-profile <file.json>,
+// the report is written when the sample calls save(), usually from end().
+// --startup-run cold|warm   tags the report, by default the first sample of a process is cold
+//                           and the following ones, under the batch runner, are warm. Cold only
+//                           means first in this process, the OS file cache may well be warm
+//
+// Per phase, the resident set is reported as the process high-water mark when the phase ends and
+// as how much the phase raised it, which is 0 when the phase stayed under an earlier peak.
+class startup_profiler
+{
+public:
+	// Scope of one init phase, e.g. initProgram
+	class phase
+	{
+	public:
+		phase(startup_profiler& Profiler, char const* Name);
+		~phase();
+
+	private:
+		phase(phase const&);
+		phase& operator=(phase const&);
+
+		startup_profiler& Profiler;
+	};
+
+	// Starts the clock and returns Title. Call it in the framework constructor arguments so that
+	// window and context creation are part of the time to first frame:
+	// framework(argc, argv, startup_profiler::start(SAMPLE_NAME), ...)
+	static char const* start(char const* Title);
+
+	startup_profiler(int argc, char* argv[]);
+
+	bool enabled() const;
+
+	// GL_ARB_timer_query as checked by the framework, call before the first phase
+	void setTimerQuery(bool Supported);
+
+	void begin(char const* Name);
+	void end();
+
+	// Bytes handed to the GL by glBufferData, glTexImage* and the like, counted in the current phase
+	void upload(std::size_t Bytes);
+
+	// Call at the end of every render(), only the first call is recorded, timed from start()
+	void frame();
+
+	bool save(std::string const& Title);
+
+private:
+	typedef std::chrono::steady_clock clock;
+
+	struct record
+	{
+		std::string Name;
+		double WallTime;
+		double CPUTime;
+		double GPUTime;
+		std::size_t PeakResidentStart;
+		std::size_t PeakResidentBytes;
+		std::size_t UploadBytes;
+		GLuint Query[2];
+	};
+
+	struct clock_start
+	{
+		clock::time_point Start;
+		bool Pending;
+		std::size_t Runs;
+	};
+
+	static clock_start& shared();
+	static double cpuTime();
+	static std::size_t peakResidentBytes();
+	GLuint timestamp();
+
+	std::string Filename;
+	bool Cold;
+	clock::time_point Start;
+	clock::time_point PhaseStart;
+	double PhaseCPUStart;
+	std::vector<record> Records;
+	std::vector<GLuint> Queries;
+	double FirstFrameTime;
+	GLuint FirstFrameQuery;
+	bool TimerQuery;
+};
@@ -0,0 +1,133 @@
+#pragma once
+
+#include "test.hpp"
+#include <cstddef>
+#include <cstring>
+#include <vector>
+
+// Compile-time std140 layout of uniform blocks declared as C++ structs. A block struct provides
+// a static name() and members() and is checked once against program reflection after link:
+//
+//	struct transform
+//	{
+//		static char const* name();
+//		static std::vector<std140::member> members(); // std140::declare<glm::mat4>("transform.MVP", 0)
+//		glm::mat4 MVP;
+//	};
+//	static_assert(offsetof(transform, MVP) == std140::offset<glm::mat4>(0), "...");
+namespace std140
+{
+	// Base alignment, size, GLSL type and matrix stride of the member types a block may declare.
+	// MATRIX_STRIDE is 0 for types that aren't matrices, as GL_UNIFORM_MATRIX_STRIDE reports them
+	template <typename genType>
+	struct layout;
+
+	template <> struct layout<float> { static GLint const ALIGNMENT = 4; static GLint const SIZE = 4; static GLenum const TYPE = GL_FLOAT; static GLint const MATRIX_STRIDE = 0; };
+	template <> struct layout<glm::vec2> { static GLint const ALIGNMENT = 8; static GLint const SIZE = 8; static GLenum const TYPE = GL_FLOAT_VEC2; static GLint const MATRIX_STRIDE = 0; };
+	template <> struct layout<glm::vec4> { static GLint const ALIGNMENT = 16; static GLint const SIZE = 16; static GLenum const TYPE = GL_FLOAT_VEC4; static GLint const MATRIX_STRIDE = 0; };
+	template <> struct layout<glm::ivec4> { static GLint const ALIGNMENT = 16; static GLint const SIZE = 16; static GLenum const TYPE = GL_INT_VEC4; static GLint const MATRIX_STRIDE = 0; };
+	template <> struct layout<glm::mat4> { static GLint const ALIGNMENT = 16; static GLint const SIZE = 64; static GLenum const TYPE = GL_FLOAT_MAT4; static GLint const MATRIX_STRIDE = 16; };
+
+	constexpr GLint align(GLint Offset, GLint Alignment)
+	{
+		return (Offset + Alignment - 1) / Alignment * Alignment;
+	}
+
+	// Offset of a member of type genType declared right after a member ending at End
+	template <typename genType>
+	constexpr GLint offset(GLint End)
+	{
+		return align(End, layout<genType>::ALIGNMENT);
+	}
+
+	template <typename genType>
+	constexpr GLint end(GLint End)
+	{
+		return offset<genType>(End) + layout<genType>::SIZE;
+	}
+
+	// Size of one block in a uniform buffer, rounded up to GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT
+	template <typename blockType>
+	GLint stride(GLint UniformBufferOffset)
+	{
+		return align(GLint(sizeof(blockType)), glm::max(UniformBufferOffset, 1));
+	}
+
+	// Arrays are checked through their first element, Name is "block.Member[0]" and ArrayStride
+	// the C++ element size. ArrayStride is 0 for members that aren't arrays.
+	struct member
+	{
+		char const* Name;
+		GLenum Type;
+		GLint Offset;
+		GLint ArrayStride;
+		GLint MatrixStride;
+	};
+
+	// Member of type genType, the GLSL type and matrix stride follow from the C++ type
+	template <typename genType>
+	member declare(char const* Name, GLint Offset, GLint ArrayStride = 0)
+	{
+		member const Member = {Name, layout<genType>::TYPE, Offset, ArrayStride, layout<genType>::MATRIX_STRIDE};
+		return Member;
+	}
+
+	// Compare the C++ declaration with the linked program, only called once after link
+	template <typename blockType>
+	bool check(GLuint ProgramName)
+	{
+		GLuint const BlockIndex = glGetUniformBlockIndex(ProgramName, blockType::name());
+		if(BlockIndex == GL_INVALID_INDEX)
+			return false;
+
+		// A GLSL array shorter than the C++ one would leave the end of each upload unused
+		GLint DataSize(0);
+		glGetActiveUniformBlockiv(ProgramName, BlockIndex, GL_UNIFORM_BLOCK_DATA_SIZE, &DataSize);
+		if(DataSize != GLint(sizeof(blockType)))
+			return false;
+
+		std::vector<member> const Members = blockType::members();
+		for(std::size_t i = 0; i < Members.size(); ++i)
+		{
+			GLuint UniformIndex(GL_INVALID_INDEX);
+			glGetUniformIndices(ProgramName, 1, &Members[i].Name, &UniformIndex);
+			if(UniformIndex == GL_INVALID_INDEX)
+				return false;
+
+			GLint UniformType(GL_NONE);
+			glGetActiveUniformsiv(ProgramName, 1, &UniformIndex, GL_UNIFORM_TYPE, &UniformType);
+			if(GLenum(UniformType) != Members[i].Type)
+				return false;
+
+			GLint UniformOffset(-1);
+			glGetActiveUniformsiv(ProgramName, 1, &UniformIndex, GL_UNIFORM_OFFSET, &UniformOffset);
+			if(UniformOffset != Members[i].Offset)
+				return false;
+
+			GLint ArrayStride(0);
+			glGetActiveUniformsiv(ProgramName, 1, &UniformIndex, GL_UNIFORM_ARRAY_STRIDE, &ArrayStride);
+			if(ArrayStride != Members[i].ArrayStride)
+				return false;
+
+			GLint MatrixStride(0);
+			glGetActiveUniformsiv(ProgramName, 1, &UniformIndex, GL_UNIFORM_MATRIX_STRIDE, &MatrixStride);
+			if(MatrixStride != Members[i].MatrixStride)
+				return false;
+		}
+
+		return true;
+	}
+
+	// Write a whole block with a single mapping, no per-member lookups. Returns false when the
+	// range couldn't be mapped or the buffer store was lost while mapped
+	template <typename blockType>
+	bool upload(GLuint BufferName, GLintptr Offset, blockType const& Block, GLbitfield Access = GL_MAP_INVALIDATE_RANGE_BIT)
+	{
+		glBindBuffer(GL_UNIFORM_BUFFER, BufferName);
+		void* Pointer = glMapBufferRange(GL_UNIFORM_BUFFER, Offset, sizeof(blockType), GL_MAP_WRITE_BIT | Access);
+		if(!Pointer)
+			return false;
+		std::memcpy(Pointer, &Block, sizeof(blockType));
+		return glUnmapBuffer(GL_UNIFORM_BUFFER) == GL_TRUE;
+	}
+}//namespace std140
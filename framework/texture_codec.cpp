@@ -0,0 +1,592 @@
+#include "texture_codec.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <condition_variable>
+#include <cstring>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// The SSSE3 path is compiled for its own target and picked at run time, the rest of the build
+// doesn't need -mssse3
+#if defined(__i386__) || defined(__x86_64__) || defined(_M_IX86) || defined(_M_X64)
+#	include <tmmintrin.h>
+#	if defined(_MSC_VER)
+#		include <intrin.h>
+#		define GLF_TARGET_SSSE3
+#	else
+#		define GLF_TARGET_SSSE3 __attribute__((target("ssse3")))
+#	endif
+#	define GLF_TEXTURE_CODEC_SSSE3
+#endif
+
+namespace
+{
+	// Workers are started once and reused by every call, a texture transcode runs several
+	// passes per mip level and spawning threads for each one cost more than small levels take.
+	// Calls from different threads are serialized.
+	class thread_pool
+	{
+	public:
+		static thread_pool& shared()
+		{
+			static thread_pool Pool;
+			return Pool;
+		}
+
+		void run(std::size_t Count, std::size_t ThreadCount, std::function<void(std::size_t)> const& Function)
+		{
+			std::lock_guard<std::mutex> Serial(this->RunMutex);
+
+			if(ThreadCount == 0)
+				ThreadCount = this->Workers.size() + 1;
+			ThreadCount = std::min(ThreadCount, Count);
+			if(ThreadCount <= 1)
+			{
+				for(std::size_t i = 0; i < Count; ++i)
+					Function(i);
+				return;
+			}
+
+			{
+				std::lock_guard<std::mutex> Lock(this->Mutex);
+				this->Function = &Function;
+				this->Count = Count;
+				this->Next = 0;
+				this->Helpers = std::min(ThreadCount - 1, this->Workers.size());
+				this->Pending = this->Helpers;
+				++this->Generation;
+			}
+			this->Wake.notify_all();
+
+			this->drain();
+
+			std::unique_lock<std::mutex> Lock(this->Mutex);
+			this->Done.wait(Lock, [this]() { return this->Pending == 0; });
+		}
+
+	private:
+		thread_pool() :
+			Function(nullptr),
+			Count(0),
+			Next(0),
+			Helpers(0),
+			Pending(0),
+			Generation(0),
+			Stop(false)
+		{
+			std::size_t const WorkerCount = std::max(1u, std::thread::hardware_concurrency()) - 1;
+			for(std::size_t i = 0; i < WorkerCount; ++i)
+				this->Workers.push_back(std::thread(&thread_pool::work, this, i));
+		}
+
+		~thread_pool()
+		{
+			{
+				std::lock_guard<std::mutex> Lock(this->Mutex);
+				this->Stop = true;
+			}
+			this->Wake.notify_all();
+			for(std::size_t i = 0; i < this->Workers.size(); ++i)
+				this->Workers[i].join();
+		}
+
+		// Rows are handed out one at a time so uneven rows don't stall the other threads
+		void drain()
+		{
+			for(std::size_t i = this->Next++; i < this->Count; i = this->Next++)
+				(*this->Function)(i);
+		}
+
+		void work(std::size_t Index)
+		{
+			std::size_t Seen(0);
+			std::unique_lock<std::mutex> Lock(this->Mutex);
+			for(;;)
+			{
+				this->Wake.wait(Lock, [&]() { return this->Stop || this->Generation != Seen; });
+				if(this->Stop)
+					return;
+
+				Seen = this->Generation;
+				if(Index >= this->Helpers)
+					continue;
+
+				Lock.unlock();
+				this->drain();
+				Lock.lock();
+
+				if(--this->Pending == 0)
+					this->Done.notify_one();
+			}
+		}
+
+		std::vector<std::thread> Workers;
+		std::mutex RunMutex;
+		std::mutex Mutex;
+		std::condition_variable Wake;
+		std::condition_variable Done;
+		std::function<void(std::size_t)> const* Function;
+		std::size_t Count;
+		std::atomic<std::size_t> Next;
+		std::size_t Helpers;
+		std::size_t Pending;
+		std::size_t Generation;
+		bool Stop;
+	};
+
+	template <typename function>
+	void parallelFor(std::size_t Count, std::size_t ThreadCount, function const& Function)
+	{
+		thread_pool::shared().run(Count, ThreadCount, Function);
+	}
+
+#	if defined(GLF_TEXTURE_CODEC_SSSE3)
+		bool hasSSSE3()
+		{
+#			if defined(_MSC_VER)
+				int Info[4];
+				__cpuid(Info, 1);
+				return (Info[2] & (1 << 9)) != 0;
+#			else
+				return __builtin_cpu_supports("ssse3") != 0;
+#			endif
+		}
+#	endif
+
+	struct block
+	{
+		unsigned short Color[2];
+		unsigned int Indices;
+	};
+
+	void unpack565(unsigned short Color, unsigned char* RGBA)
+	{
+		unsigned int const R = (Color >> 11) & 31;
+		unsigned int const G = (Color >> 5) & 63;
+		unsigned int const B = Color & 31;
+		RGBA[0] = static_cast<unsigned char>((R << 3) | (R >> 2));
+		RGBA[1] = static_cast<unsigned char>((G << 2) | (G >> 4));
+		RGBA[2] = static_cast<unsigned char>((B << 3) | (B >> 2));
+		RGBA[3] = 255;
+	}
+
+	unsigned short pack565(unsigned char const* RGB)
+	{
+		return static_cast<unsigned short>(((RGB[0] * 31 + 127) / 255) << 11 | ((RGB[1] * 63 + 127) / 255) << 5 | ((RGB[2] * 31 + 127) / 255));
+	}
+
+	// 4 RGBA8 colors, the last one is transparent black in three color mode
+	void palette(block const& Block, unsigned char Palette[16])
+	{
+		unpack565(Block.Color[0], Palette + 0);
+		unpack565(Block.Color[1], Palette + 4);
+
+		for(int c = 0; c < 3; ++c)
+		{
+			if(Block.Color[0] > Block.Color[1])
+			{
+				Palette[8 + c] = static_cast<unsigned char>((2 * Palette[c] + Palette[4 + c] + 1) / 3);
+				Palette[12 + c] = static_cast<unsigned char>((Palette[c] + 2 * Palette[4 + c] + 1) / 3);
+			}
+			else
+			{
+				Palette[8 + c] = static_cast<unsigned char>((Palette[c] + Palette[4 + c]) / 2);
+				Palette[12 + c] = 0;
+			}
+		}
+		Palette[11] = 255;
+		Palette[15] = Block.Color[0] > Block.Color[1] ? 255 : 0;
+	}
+
+	block readBlock(unsigned char const* Data)
+	{
+		block Block;
+		Block.Color[0] = static_cast<unsigned short>(Data[0] | Data[1] << 8);
+		Block.Color[1] = static_cast<unsigned short>(Data[2] | Data[3] << 8);
+		Block.Indices = unsigned(Data[4]) | unsigned(Data[5]) << 8 | unsigned(Data[6]) << 16 | unsigned(Data[7]) << 24;
+		return Block;
+	}
+
+	// Copies a decoded 4x4 tile, clipped against the image for the small mip levels
+	void storeTile(unsigned char const Tile[64], std::size_t X, std::size_t Y, std::size_t Width, std::size_t Height, unsigned char* RGBA)
+	{
+		std::size_t const TileWidth = std::min<std::size_t>(4, Width - X);
+		std::size_t const TileHeight = std::min<std::size_t>(4, Height - Y);
+		for(std::size_t j = 0; j < TileHeight; ++j)
+			std::memcpy(RGBA + ((Y + j) * Width + X) * 4, Tile + j * 16, TileWidth * 4);
+	}
+
+	void decodeRowScalar(unsigned char const* Data, std::size_t Row, std::size_t Width, std::size_t Height, unsigned char* RGBA)
+	{
+		std::size_t const BlockCountX = (Width + 3) / 4;
+		for(std::size_t BlockX = 0; BlockX < BlockCountX; ++BlockX)
+		{
+			block const Block = readBlock(Data + (Row * BlockCountX + BlockX) * bc1::BLOCK_SIZE);
+
+			unsigned char Palette[16];
+			palette(Block, Palette);
+
+			unsigned char Tile[64];
+			for(std::size_t i = 0; i < 16; ++i)
+				std::memcpy(Tile + i * 4, Palette + ((Block.Indices >> (i * 2)) & 3) * 4, 4);
+
+			storeTile(Tile, BlockX * 4, Row * 4, Width, Height, RGBA);
+		}
+	}
+
+#	if defined(GLF_TEXTURE_CODEC_SSSE3)
+		// Byte shuffle masks selecting 4 palette entries from one row of 2 bit indices
+		struct shuffle_table
+		{
+			shuffle_table()
+			{
+				for(int Row = 0; Row < 256; ++Row)
+					for(int Texel = 0; Texel < 4; ++Texel)
+						for(int Byte = 0; Byte < 4; ++Byte)
+							this->Mask[Row][Texel * 4 + Byte] = static_cast<unsigned char>(((Row >> (Texel * 2)) & 3) * 4 + Byte);
+			}
+
+			alignas(16) unsigned char Mask[256][16];
+		};
+
+		GLF_TARGET_SSSE3 void decodeRowSSSE3(unsigned char const* Data, std::size_t Row, std::size_t Width, std::size_t Height, unsigned char* RGBA)
+		{
+			static shuffle_table const Table;
+
+			std::size_t const BlockCountX = (Width + 3) / 4;
+			bool const Interior = Row * 4 + 4 <= Height;
+			for(std::size_t BlockX = 0; BlockX < BlockCountX; ++BlockX)
+			{
+				block const Block = readBlock(Data + (Row * BlockCountX + BlockX) * bc1::BLOCK_SIZE);
+
+				alignas(16) unsigned char Palette[16];
+				palette(Block, Palette);
+				__m128i const Colors = _mm_load_si128(reinterpret_cast<__m128i const*>(Palette));
+
+				if(Interior && BlockX * 4 + 4 <= Width)
+				{
+					for(std::size_t j = 0; j < 4; ++j)
+					{
+						__m128i const Mask = _mm_load_si128(reinterpret_cast<__m128i const*>(Table.Mask[(Block.Indices >> (j * 8)) & 0xFF]));
+						_mm_storeu_si128(reinterpret_cast<__m128i*>(RGBA + ((Row * 4 + j) * Width + BlockX * 4) * 4), _mm_shuffle_epi8(Colors, Mask));
+					}
+				}
+				else
+				{
+					alignas(16) unsigned char Tile[64];
+					for(std::size_t j = 0; j < 4; ++j)
+					{
+						__m128i const Mask = _mm_load_si128(reinterpret_cast<__m128i const*>(Table.Mask[(Block.Indices >> (j * 8)) & 0xFF]));
+						_mm_store_si128(reinterpret_cast<__m128i*>(Tile + j * 16), _mm_shuffle_epi8(Colors, Mask));
+					}
+					storeTile(Tile, BlockX * 4, Row * 4, Width, Height, RGBA);
+				}
+			}
+		}
+#	endif
+
+	int distance(unsigned char const* A, unsigned char const* B)
+	{
+		int const R = int(A[0]) - int(B[0]);
+		int const G = int(A[1]) - int(B[1]);
+		int const Bl = int(A[2]) - int(B[2]);
+		return R * R + G * G + Bl * Bl;
+	}
+
+	void encodeBlock(unsigned char const Tile[64], unsigned char* Data)
+	{
+		unsigned char Min[3] = {255, 255, 255};
+		unsigned char Max[3] = {0, 0, 0};
+		for(std::size_t i = 0; i < 16; ++i)
+			for(std::size_t c = 0; c < 3; ++c)
+			{
+				Min[c] = std::min(Min[c], Tile[i * 4 + c]);
+				Max[c] = std::max(Max[c], Tile[i * 4 + c]);
+			}
+
+		// Inset the box to reduce the error of the interpolated colors
+		for(std::size_t c = 0; c < 3; ++c)
+		{
+			int const Inset = (int(Max[c]) - int(Min[c])) >> 4;
+			Min[c] = static_cast<unsigned char>(std::min(255, int(Min[c]) + Inset));
+			Max[c] = static_cast<unsigned char>(std::max(0, int(Max[c]) - Inset));
+		}
+
+		block Block;
+		Block.Color[0] = pack565(Max);
+		Block.Color[1] = pack565(Min);
+		Block.Indices = 0;
+
+		// Four color mode needs Color[0] > Color[1], equal endpoints only ever use index 0
+		if(Block.Color[0] < Block.Color[1])
+			std::swap(Block.Color[0], Block.Color[1]);
+
+		if(Block.Color[0] != Block.Color[1])
+		{
+			unsigned char Palette[16];
+			palette(Block, Palette);
+
+			for(std::size_t i = 0; i < 16; ++i)
+			{
+				unsigned int Best = 0;
+				int BestDistance = distance(Tile + i * 4, Palette);
+				for(unsigned int k = 1; k < 4; ++k)
+				{
+					int const Distance = distance(Tile + i * 4, Palette + k * 4);
+					if(Distance < BestDistance)
+					{
+						Best = k;
+						BestDistance = Distance;
+					}
+				}
+				Block.Indices |= Best << (i * 2);
+			}
+		}
+
+		Data[0] = static_cast<unsigned char>(Block.Color[0] & 0xFF);
+		Data[1] = static_cast<unsigned char>(Block.Color[0] >> 8);
+		Data[2] = static_cast<unsigned char>(Block.Color[1] & 0xFF);
+		Data[3] = static_cast<unsigned char>(Block.Color[1] >> 8);
+		for(std::size_t i = 0; i < 4; ++i)
+			Data[4 + i] = static_cast<unsigned char>((Block.Indices >> (i * 8)) & 0xFF);
+	}
+
+	struct srgb_table
+	{
+		srgb_table()
+		{
+			for(int i = 0; i < 256; ++i)
+			{
+				float const Value = float(i) / 255.0f;
+				this->Linear[i] = Value <= 0.04045f ? Value / 12.92f : std::pow((Value + 0.055f) / 1.055f, 2.4f);
+			}
+			for(int i = 0; i < 4096; ++i)
+			{
+				float const Value = float(i) / 4095.0f;
+				float const Encoded = Value <= 0.0031308f ? Value * 12.92f : 1.055f * std::pow(Value, 1.0f / 2.4f) - 0.055f;
+				this->Encode[i] = static_cast<unsigned char>(std::min(255.0f, Encoded * 255.0f + 0.5f));
+			}
+		}
+
+		unsigned char encode(float Linear) const
+		{
+			return this->Encode[int(std::min(std::max(Linear, 0.0f), 1.0f) * 4095.0f + 0.5f)];
+		}
+
+		float Linear[256];
+		unsigned char Encode[4096];
+	};
+
+	srgb_table const& srgb()
+	{
+		static srgb_table const Table;
+		return Table;
+	}
+
+	unsigned char encodeAlpha(float Alpha)
+	{
+		return static_cast<unsigned char>(std::min(std::max(Alpha, 0.0f), 1.0f) * 255.0f + 0.5f);
+	}
+
+	// Kaiser windowed sinc for a 2:1 reduction, taps are in source texels
+	struct kaiser_filter
+	{
+		kaiser_filter()
+		{
+			float const Alpha = 4.0f;
+			float Sum = 0.0f;
+			for(int i = 0; i < TAPS; ++i)
+			{
+				float const X = (float(i - TAPS / 2) + 0.5f) * 0.5f;
+				float const Ratio = X / (float(TAPS) * 0.25f);
+				float const Window = bessel(Alpha * std::sqrt(std::max(0.0f, 1.0f - Ratio * Ratio))) / bessel(Alpha);
+				float const Pi = 3.14159265358979f;
+				float const Sinc = std::sin(Pi * X) / (Pi * X);
+				this->Weight[i] = Sinc * Window;
+				Sum += this->Weight[i];
+			}
+			for(int i = 0; i < TAPS; ++i)
+				this->Weight[i] /= Sum;
+		}
+
+		// Zeroth order modified Bessel function of the first kind
+		static float bessel(float X)
+		{
+			float Sum = 1.0f;
+			float Term = 1.0f;
+			for(int k = 1; k < 16; ++k)
+			{
+				Term *= (X * 0.5f / float(k)) * (X * 0.5f / float(k));
+				Sum += Term;
+			}
+			return Sum;
+		}
+
+		enum
+		{
+			TAPS = 8
+		};
+
+		float Weight[TAPS];
+	};
+
+	void downsampleBox(unsigned char const* Source, std::size_t Width, std::size_t Height, unsigned char* Destination, std::size_t ThreadCount)
+	{
+		std::size_t const DstWidth = std::max<std::size_t>(1, Width / 2);
+		std::size_t const DstHeight = std::max<std::size_t>(1, Height / 2);
+		srgb_table const& Table = srgb();
+
+		parallelFor(DstHeight, ThreadCount, [&](std::size_t y)
+		{
+			std::size_t const y0 = std::min(y * 2, Height - 1);
+			std::size_t const y1 = std::min(y * 2 + 1, Height - 1);
+			for(std::size_t x = 0; x < DstWidth; ++x)
+			{
+				std::size_t const x0 = std::min(x * 2, Width - 1);
+				std::size_t const x1 = std::min(x * 2 + 1, Width - 1);
+				unsigned char const* Texel[4] =
+				{
+					Source + (y0 * Width + x0) * 4, Source + (y0 * Width + x1) * 4,
+					Source + (y1 * Width + x0) * 4, Source + (y1 * Width + x1) * 4
+				};
+
+				unsigned char* Output = Destination + (y * DstWidth + x) * 4;
+				for(std::size_t c = 0; c < 3; ++c)
+					Output[c] = Table.encode((Table.Linear[Texel[0][c]] + Table.Linear[Texel[1][c]] + Table.Linear[Texel[2][c]] + Table.Linear[Texel[3][c]]) * 0.25f);
+				Output[3] = static_cast<unsigned char>((Texel[0][3] + Texel[1][3] + Texel[2][3] + Texel[3][3] + 2) / 4);
+			}
+		});
+	}
+
+	void downsampleKaiser(unsigned char const* Source, std::size_t Width, std::size_t Height, unsigned char* Destination, std::size_t ThreadCount)
+	{
+		static kaiser_filter const Filter;
+		std::size_t const DstWidth = std::max<std::size_t>(1, Width / 2);
+		std::size_t const DstHeight = std::max<std::size_t>(1, Height / 2);
+		srgb_table const& Table = srgb();
+		int const Taps = kaiser_filter::TAPS;
+
+		// Horizontal pass into linear floats, vertical pass back to sRGB
+		std::vector<float> Temp(DstWidth * Height * 4);
+		parallelFor(Height, ThreadCount, [&](std::size_t y)
+		{
+			for(std::size_t x = 0; x < DstWidth; ++x)
+			{
+				float Sum[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+				for(int t = 0; t < Taps; ++t)
+				{
+					std::ptrdiff_t const Sx = std::ptrdiff_t(x * 2) + t - Taps / 2 + 1;
+					std::size_t const Cx = std::size_t(std::min<std::ptrdiff_t>(std::max<std::ptrdiff_t>(Sx, 0), std::ptrdiff_t(Width) - 1));
+					unsigned char const* Texel = Source + (y * Width + Cx) * 4;
+					for(int c = 0; c < 3; ++c)
+						Sum[c] += Table.Linear[Texel[c]] * Filter.Weight[t];
+					Sum[3] += float(Texel[3]) / 255.0f * Filter.Weight[t];
+				}
+				std::memcpy(&Temp[(y * DstWidth + x) * 4], Sum, sizeof(Sum));
+			}
+		});
+
+		parallelFor(DstHeight, ThreadCount, [&](std::size_t y)
+		{
+			for(std::size_t x = 0; x < DstWidth; ++x)
+			{
+				float Sum[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+				for(int t = 0; t < Taps; ++t)
+				{
+					std::ptrdiff_t const Sy = std::ptrdiff_t(y * 2) + t - Taps / 2 + 1;
+					std::size_t const Cy = std::size_t(std::min<std::ptrdiff_t>(std::max<std::ptrdiff_t>(Sy, 0), std::ptrdiff_t(Height) - 1));
+					float const* Texel = &Temp[(Cy * DstWidth + x) * 4];
+					for(int c = 0; c < 4; ++c)
+						Sum[c] += Texel[c] * Filter.Weight[t];
+				}
+
+				unsigned char* Output = Destination + (y * DstWidth + x) * 4;
+				for(int c = 0; c < 3; ++c)
+					Output[c] = Table.encode(Sum[c]);
+				Output[3] = encodeAlpha(Sum[3]);
+			}
+		});
+	}
+}//namespace
+
+namespace bc1
+{
+	std::size_t size(std::size_t Width, std::size_t Height)
+	{
+		return ((Width + 3) / 4) * ((Height + 3) / 4) * BLOCK_SIZE;
+	}
+
+	void decodeScalar(void const* Blocks, std::size_t Width, std::size_t Height, unsigned char* RGBA)
+	{
+		unsigned char const* Data = static_cast<unsigned char const*>(Blocks);
+		for(std::size_t Row = 0; Row < (Height + 3) / 4; ++Row)
+			decodeRowScalar(Data, Row, Width, Height, RGBA);
+	}
+
+	void decode(void const* Blocks, std::size_t Width, std::size_t Height, unsigned char* RGBA, std::size_t ThreadCount)
+	{
+		unsigned char const* Data = static_cast<unsigned char const*>(Blocks);
+
+#		if defined(GLF_TEXTURE_CODEC_SSSE3)
+			static bool const SSSE3 = hasSSSE3();
+			if(SSSE3)
+			{
+				parallelFor((Height + 3) / 4, ThreadCount, [&](std::size_t Row)
+				{
+					decodeRowSSSE3(Data, Row, Width, Height, RGBA);
+				});
+				return;
+			}
+#		endif
+
+		parallelFor((Height + 3) / 4, ThreadCount, [&](std::size_t Row)
+		{
+			decodeRowScalar(Data, Row, Width, Height, RGBA);
+		});
+	}
+
+	void encode(unsigned char const* RGBA, std::size_t Width, std::size_t Height, void* Blocks, std::size_t ThreadCount)
+	{
+		unsigned char* Data = static_cast<unsigned char*>(Blocks);
+		std::size_t const BlockCountX = (Width + 3) / 4;
+		parallelFor((Height + 3) / 4, ThreadCount, [&](std::size_t Row)
+		{
+			for(std::size_t BlockX = 0; BlockX < BlockCountX; ++BlockX)
+			{
+				// Edge texels are replicated to fill the tiles of the small mip levels
+				unsigned char Tile[64];
+				for(std::size_t j = 0; j < 4; ++j)
+					for(std::size_t i = 0; i < 4; ++i)
+					{
+						std::size_t const x = std::min(BlockX * 4 + i, Width - 1);
+						std::size_t const y = std::min(Row * 4 + j, Height - 1);
+						std::memcpy(Tile + (j * 4 + i) * 4, RGBA + (y * Width + x) * 4, 4);
+					}
+
+				encodeBlock(Tile, Data + (Row * BlockCountX + BlockX) * BLOCK_SIZE);
+			}
+		});
+	}
+}//namespace bc1
+
+namespace mipmap
+{
+	std::size_t levels(std::size_t Width, std::size_t Height)
+	{
+		std::size_t Levels = 1;
+		for(std::size_t Size = std::max(Width, Height); Size > 1; Size /= 2)
+			++Levels;
+		return Levels;
+	}
+
+	void downsample(unsigned char const* Source, std::size_t Width, std::size_t Height, unsigned char* Destination, filter Filter, std::size_t ThreadCount)
+	{
+		if(Filter == FILTER_KAISER)
+			downsampleKaiser(Source, Width, Height, Destination, ThreadCount);
+		else
+			downsampleBox(Source, Width, Height, Destination, ThreadCount);
+	}
+}//namespace mipmap
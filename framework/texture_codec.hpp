@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstddef>
+
+// CPU side texture processing for drivers without S3TC or sources without a full mip chain.
+// Images are tightly packed RGBA8, work is split in rows of 4x4 tiles over ThreadCount threads
+// of a pool shared by every call, 0 meaning one per hardware thread.
+namespace bc1
+{
+	std::size_t const BLOCK_SIZE = 8;
+
+	std::size_t size(std::size_t Width, std::size_t Height);
+
+	// Uses SSSE3 byte shuffles when the CPU supports them, decodeScalar otherwise
+	void decode(void const* Blocks, std::size_t Width, std::size_t Height, unsigned char* RGBA, std::size_t ThreadCount = 0);
+	void decodeScalar(void const* Blocks, std::size_t Width, std::size_t Height, unsigned char* RGBA);
+
+	// Bounding box endpoints inset by 1/16 of the range, nearest palette entry per texel.
+	// Alpha is ignored, BC1 is encoded in opaque four color mode.
+	void encode(unsigned char const* RGBA, std::size_t Width, std::size_t Height, void* Blocks, std::size_t ThreadCount = 0);
+}//namespace bc1
+
+namespace mipmap
+{
+	enum filter
+	{
+		FILTER_BOX,
+		FILTER_KAISER
+	};
+
+	std::size_t levels(std::size_t Width, std::size_t Height);
+
+	// Next mip level of an sRGB RGBA8 image, color is filtered in linear space and alpha as is
+	void downsample(unsigned char const* Source, std::size_t Width, std::size_t Height, unsigned char* Destination, filter Filter, std::size_t ThreadCount = 0);
+}//namespace mipmap
@@ -1,10 +1,24 @@
 #include "test.hpp"
+#include "asset_pack.hpp"
+#include "batch.hpp"
+#include "benchmark.hpp"
+#include "frame_pacer.hpp"
+#include "geometry_pool.hpp"
+#include "memory_tracker.hpp"
+#include "options.hpp"
+#include "shader_loader.hpp"
+#include "startup_profiler.hpp"
+#include "std140.hpp"
+#include <cstddef>
 
 namespace
 {
 	char const* VERT_SHADER_SOURCE("gl-320/draw-range-elements.vert");
 	char const* FRAG_SHADER_SOURCE("gl-320/draw-range-elements.frag");
 
+	char const* SAMPLE_NAME("gl-320-draw-range-elements");
+	char const* ASSET_PACK("gl-320.pack");
+
 	GLsizei const VertexCount(8);
 	GLsizeiptr const VertexSize = VertexCount * sizeof(glm::vec2);
 	glm::vec2 const VertexData[VertexCount] =
@@ -19,46 +33,102 @@ namespace
 		glm::vec2(-0.5f, 0.5f)
 	};
 
-	GLsizei const ElementCount(12);
+	// Both quads share the same indices, relative to the base vertex of each mesh
+	GLsizei const ElementCount(6);
 	GLsizeiptr const ElementSize = ElementCount * sizeof(GLushort);
 	GLushort const ElementData[ElementCount] =
 	{
 		0, 1, 2,
-		2, 3, 0,
-		4, 5, 6,
-		6, 7, 4
+		2, 3, 0
 	};
 
+	// Arenas shared by every mesh using the vec2 position format
+	GLsizei const PoolVertexCapacity(1 << 16);
+	GLsizei const PoolElementCapacity(1 << 18);
+	std::size_t const PoolDefragmentBudget(64 << 10);
+
+	std::vector<geometry_pool::attribute> vertexFormat()
+	{
+		geometry_pool::attribute const Position = {semantic::attr::POSITION, 2, GL_FLOAT, GL_FALSE, 0};
+		return std::vector<geometry_pool::attribute>(1, Position);
+	}
+
+	namespace mesh
+	{
+		enum type
+		{
+			SKEWED,
+			SQUARE,
+			MAX
+		};
+	}//namespace mesh
+
+	struct transform
+	{
+		static char const* name()
+		{
+			return "transform";
+		}
+
+		static std::vector<std140::member> members()
+		{
+			std140::member const Members[] =
+			{
+				std140::declare<glm::mat4>("transform.MVP", GLint(offsetof(transform, MVP)))
+			};
+			return std::vector<std140::member>(Members, Members + sizeof(Members) / sizeof(Members[0]));
+		}
+
+		glm::mat4 MVP;
+	};
+
+	static_assert(offsetof(transform, MVP) == std140::offset<glm::mat4>(0), "transform.MVP doesn't follow std140");
+	static_assert(sizeof(transform) == std140::end<glm::mat4>(0), "transform size doesn't follow std140");
+
 	namespace buffer
 	{
 		enum type
 		{
-			VERTEX,
-			ELEMENT,
 			TRANSFORM,
 			MAX
 		};
 	}//namespace buffer
 
 	GLuint ProgramName(0);
-	GLuint VertexArrayName(0);
 	std::vector<GLuint> BufferName(buffer::MAX);
 }//namespace
 
+// 批量运行时多个样例链接进同一个进程 sample放在匿名命名空间里避免同名类冲突 不额外缩进
+namespace
+{
 class sample : public framework
 {
 public:
 	sample(int argc, char* argv[]) :
-		framework(argc, argv, "gl-320-draw-range-elements", framework::CORE, 3, 2),
-		VertexArrayName(0),
+		framework(argc, argv, startup_profiler::start(SAMPLE_NAME), framework::CORE, 3, 2,
+			benchmark::windowSize(argc, argv), glm::vec2(0.0f), glm::vec2(0.0f, 4.0f), benchmark::frameCount(argc, argv)),
+		Pack(getDataDirectory() + ASSET_PACK),
+		Profiler(argc, argv),
+		Benchmark(argc, argv),
+		Pacer(argc, argv),
+		Memory(argc, argv, SAMPLE_NAME),
+		TransformStride(0),
+		Pool(vertexFormat(), sizeof(glm::vec2), PoolVertexCapacity, PoolElementCapacity),
 		ProgramName(0),
 		UniformTransform(-1)
 	{}
 
 private:
+	pack::reader Pack;
+	startup_profiler Profiler;
+	benchmark Benchmark;
+	frame_pacer Pacer;
+	memory_tracker Memory;
+	GLintptr TransformStride;
+	geometry_pool Pool;
+	std::array<geometry_pool::handle, mesh::MAX> MeshHandle;
 	std::array<GLuint, buffer::MAX> BufferName;
 	GLuint ProgramName;
-	GLuint VertexArrayName;
 	GLint UniformTransform;
 
 	bool initTest()
@@ -72,34 +142,40 @@ private:
 	bool initProgram()
 	{
 		bool Validated = true;
-	
+
 		// Create program
 		if(Validated)
 		{	
 			//创建一个编译器
 			compiler Compiler;
-			//获取顶点着色器
-			GLuint VertShaderName = Compiler.create(GL_VERTEX_SHADER, getDataDirectory() + VERT_SHADER_SOURCE, "--version 150 --profile core");
-			//获取片段着色器
-			GLuint FragShaderName = Compiler.create(GL_FRAGMENT_SHADER, getDataDirectory() + FRAG_SHADER_SOURCE, "--version 150 --profile core");
 			//创建一个GPU工艺流程单
 			ProgramName = glCreateProgram();
-			// 把shader装进GPU工艺流程单
-			glAttachShader(ProgramName, VertShaderName);
-			glAttachShader(ProgramName, FragShaderName);
-			
-			// 绑定顶点输入变量
-			// 把vertex shader里的Postion变量绑定到semantic::attr::POSITION编号的GPU内存里
-			glBindAttribLocation(ProgramName, semantic::attr::POSITION, "Position");
-
-			// 绑定片段着色器的输出变量
-			// 把fragment shader里Color写到GPU的第COLOR个GPU颜色缓冲区内
-			glBindFragDataLocation(ProgramName, semantic::frag::COLOR, "Color");
-			glLinkProgram(ProgramName);
+
+			// 批量运行时 之前链接过的工艺单直接从程序二进制恢复 跳过编译和链接
+			char const* const Sources[] = {VERT_SHADER_SOURCE, FRAG_SHADER_SOURCE};
+			std::string const Key = batch::programKey(this->Pack, SAMPLE_NAME, Sources, 2);
+			bool const Cached = batch::loadProgram(ProgramName, Key);
+			if(!Cached)
+			{
+				// 获取顶点着色器和片段着色器 优先从资源包中读取 并装进GPU工艺流程单
+				Validated = attachShader(this->Pack, Compiler, ProgramName, GL_VERTEX_SHADER, VERT_SHADER_SOURCE) && Validated;
+				Validated = attachShader(this->Pack, Compiler, ProgramName, GL_FRAGMENT_SHADER, FRAG_SHADER_SOURCE) && Validated;
+
+				// 绑定顶点输入变量
+				// 把vertex shader里的Postion变量绑定到semantic::attr::POSITION编号的GPU内存里
+				glBindAttribLocation(ProgramName, semantic::attr::POSITION, "Position");
+
+				// 绑定片段着色器的输出变量
+				// 把fragment shader里Color写到GPU的第COLOR个GPU颜色缓冲区内
+				glBindFragDataLocation(ProgramName, semantic::frag::COLOR, "Color");
+				glLinkProgram(ProgramName);
+			}
 
 			//检查编译错误与连接错误
 			Validated = Validated && Compiler.check();
 			Validated = Validated && Compiler.check_program(ProgramName);
+			if(Validated && !Cached)
+				batch::storeProgram(ProgramName, Key);
 		}
 
 		// Get variables locations
@@ -108,7 +184,10 @@ private:
 			// 从.vert中读取transform的索引，并绑定到 TRANSFORM0 上，告诉GPU 以后读取transform块数据
 			// 只需用插槽TRANSFORM0来获取
 			// 用哪一个UBO提供数据
-			glUniformBlockBinding(ProgramName, glGetUniformBlockIndex(ProgramName, "transform"), semantic::uniform::TRANSFORM0);
+			// 同时检查GPU反射出的std140偏移和C++中的声明一致
+			Validated = std140::check<transform>(ProgramName);
+			if(Validated)
+				glUniformBlockBinding(ProgramName, glGetUniformBlockIndex(ProgramName, transform::name()), semantic::uniform::TRANSFORM0);
 		}
 
 		// 返回OpenGL初始化是否正确
@@ -119,78 +198,101 @@ private:
 	{
 		glGenBuffers(buffer::MAX, &BufferName[0]);
 
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, BufferName[buffer::ELEMENT]);
-		glBufferData(GL_ELEMENT_ARRAY_BUFFER, ElementSize, ElementData, GL_STATIC_DRAW);
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+		this->Pool.init();
 
-		glBindBuffer(GL_ARRAY_BUFFER, BufferName[buffer::VERTEX]);
-		glBufferData(GL_ARRAY_BUFFER, VertexSize, VertexData, GL_STATIC_DRAW);
-		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		MeshHandle[mesh::SKEWED] = this->Pool.allocate(&VertexData[0], VertexCount / 2, ElementData, ElementCount);
+		MeshHandle[mesh::SQUARE] = this->Pool.allocate(&VertexData[VertexCount / 2], VertexCount / 2, ElementData, ElementCount);
+		if(MeshHandle[mesh::SKEWED] == geometry_pool::INVALID || MeshHandle[mesh::SQUARE] == geometry_pool::INVALID)
+			return false;
+		this->Profiler.upload(VertexSize + ElementSize * 2);
+		this->Memory.buffer(memory::VERTEX, this->Pool.vertexBuffer(), this->Pool.vertexBufferSize());
+		this->Memory.buffer(memory::INDEX, this->Pool.indexBuffer(), this->Pool.indexBufferSize());
 
 		GLint UniformBufferOffset(0);
 		glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &UniformBufferOffset);
-		GLint UniformBlockSize = glm::max(GLint(sizeof(glm::mat4)), UniformBufferOffset);
+		this->TransformStride = std140::stride<transform>(UniformBufferOffset);
 
+		// One transform per frame in flight, the frame pacer guarantees the GPU is done with the slot being written
 		glBindBuffer(GL_UNIFORM_BUFFER, BufferName[buffer::TRANSFORM]);
-		glBufferData(GL_UNIFORM_BUFFER, UniformBlockSize, NULL, GL_DYNAMIC_DRAW);
+		glBufferData(GL_UNIFORM_BUFFER, this->TransformStride * GLintptr(this->Pacer.framesInFlight()), NULL, GL_DYNAMIC_DRAW);
+		this->Memory.buffer(memory::UNIFORM, BufferName[buffer::TRANSFORM], this->TransformStride * GLintptr(this->Pacer.framesInFlight()));
 		glBindBuffer(GL_UNIFORM_BUFFER, 0);
 
 		return this->checkError("initBuffer");
 	}
 
-	bool initVertexArray()
-	{
-		glGenVertexArrays(1, &VertexArrayName);
-		glBindVertexArray(VertexArrayName);
-			glBindBuffer(GL_ARRAY_BUFFER, BufferName[buffer::VERTEX]);
-			glVertexAttribPointer(semantic::attr::POSITION, 2, GL_FLOAT, GL_FALSE, 0, 0);
-
-			glEnableVertexAttribArray(semantic::attr::POSITION);
-
-			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, BufferName[buffer::ELEMENT]);
-		glBindVertexArray(0);
-
-		return this->checkError("initVertexArray");
-	}
-
 	bool begin()
 	{
 		bool Validated = true;
 
+		// Extensions are checked once by the framework and handed to the tools that time or measure
+		bool const TimerQuery = this->checkExtension("GL_ARB_timer_query");
+		this->Profiler.setTimerQuery(TimerQuery);
+		this->Benchmark.setTimerQuery(TimerQuery);
+		this->Pacer.setTimerQuery(TimerQuery);
+		batch::setProgramBinary(this->checkExtension("GL_ARB_get_program_binary"));
+		if(this->Memory.enabled())
+			this->Memory.setDriverQuery(
+				this->checkExtension("GL_NVX_gpu_memory_info") ? memory::DRIVER_NVX :
+				this->checkExtension("GL_ATI_meminfo") ? memory::DRIVER_ATI : memory::DRIVER_NONE);
+
 		if(Validated)
+		{
+			startup_profiler::phase Phase(this->Profiler, "initTest");
 			Validated = initTest();
+		}
 		if(Validated)
+		{
+			startup_profiler::phase Phase(this->Profiler, "initProgram");
 			Validated = initProgram();
+		}
 		if(Validated)
+		{
+			startup_profiler::phase Phase(this->Profiler, "initBuffer");
 			Validated = initBuffer();
-		if(Validated)
-			Validated = initVertexArray();
+		}
 
 		return Validated && this->checkError("begin");
 	}
 
 	bool end()
 	{
+		// Checked while the objects still exist, deleting a bound object would unbind it
+		bool Validated = batch::resetState(SAMPLE_NAME);
+
+		// Releases are recorded as objects are deleted, the report keeps the peak and shows leaks as live bytes
+		GLuint const PoolBufferName[] = {this->Pool.vertexBuffer(), this->Pool.indexBuffer(), this->Pool.copyBuffer()};
+		this->Memory.release(memory::BUFFER, buffer::MAX, &BufferName[0]);
+		this->Memory.release(memory::BUFFER, 3, PoolBufferName);
+
 		glDeleteBuffers(buffer::MAX, &BufferName[0]);
 		glDeleteProgram(ProgramName);
-		glDeleteVertexArrays(1, &VertexArrayName);
+		this->Pool.release();
 
-		return true;
+		Validated = this->Profiler.save(SAMPLE_NAME) && Validated;
+		Validated = this->Benchmark.save(SAMPLE_NAME) && Validated;
+		Validated = this->Pacer.save(SAMPLE_NAME) && Validated;
+		Validated = this->Memory.save() && Validated;
+
+		return Validated;
 	}
 
 	bool render()
 	{
+		this->Pacer.begin();
+		this->Benchmark.begin();
+
 		glm::vec2 WindowSize(this->getWindowSize());
+		GLintptr const TransformOffset = this->TransformStride * GLintptr(this->Pacer.slot());
 
 		{
-			glBindBuffer(GL_UNIFORM_BUFFER, BufferName[buffer::TRANSFORM]);
-			glm::mat4* Pointer = (glm::mat4*)glMapBufferRange(GL_UNIFORM_BUFFER, 0, sizeof(glm::mat4), GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
-
 			glm::mat4 Projection = glm::perspective(glm::pi<float>() * 0.25f, WindowSize.x / 3.0f / WindowSize.y, 0.1f, 100.0f);
 			glm::mat4 Model = glm::mat4(1.0f);
 
-			*Pointer = Projection * this->view() * Model;
-			glUnmapBuffer(GL_UNIFORM_BUFFER);
+			transform Transform;
+			Transform.MVP = Projection * this->view() * Model;
+			if(!std140::upload(BufferName[buffer::TRANSFORM], TransformOffset, Transform, GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT))
+				return false;
 		}
 
 		glViewport(0, 0, static_cast<GLsizei>(WindowSize.x), static_cast<GLsizei>(WindowSize.y));
@@ -201,23 +303,33 @@ private:
 
 		glUseProgram(ProgramName);
 
-		glBindBufferBase(GL_UNIFORM_BUFFER, semantic::uniform::TRANSFORM0, BufferName[buffer::TRANSFORM]);
-		glBindVertexArray(VertexArrayName);
+		glBindBufferRange(GL_UNIFORM_BUFFER, semantic::uniform::TRANSFORM0, BufferName[buffer::TRANSFORM], TransformOffset, sizeof(transform));
+		this->Pool.bind();
 
+		// Every mesh lives in the same arenas, only the first index and the base vertex change between draws
 		glViewport(static_cast<GLint>(WindowSize.x * 0 / 3), 0, static_cast<GLsizei>(WindowSize.x / 3), static_cast<GLsizei>(WindowSize.y));
-		glDrawElements(GL_TRIANGLES, ElementCount / 2, GL_UNSIGNED_SHORT, BUFFER_OFFSET(0));
+		this->Pool.draw(MeshHandle[mesh::SKEWED]);
 
 		glViewport(static_cast<GLint>(WindowSize.x * 1 / 3), 0, static_cast<GLsizei>(WindowSize.x / 3), static_cast<GLsizei>(WindowSize.y));
-		glDrawElementsInstancedBaseVertex(GL_TRIANGLES, ElementCount / 2, GL_UNSIGNED_SHORT, BUFFER_OFFSET(sizeof(GLushort) * ElementCount / 2), 1, 0);
+		this->Pool.draw(MeshHandle[mesh::SQUARE]);
 
 		glViewport(static_cast<GLint>(WindowSize.x * 2 / 3), 0, static_cast<GLsizei>(WindowSize.x / 3), static_cast<GLsizei>(WindowSize.y));
-		glDrawElementsInstancedBaseVertex(GL_TRIANGLES, ElementCount / 2, GL_UNSIGNED_SHORT, BUFFER_OFFSET(0), 1, VertexCount / 2);
+		this->Pool.draw(MeshHandle[mesh::SQUARE]);
+
+		// Returns immediately once the arenas are compact, the scratch buffer only grows when meshes move
+		if(this->Pool.defragment(PoolDefragmentBudget) > 0)
+			this->Memory.buffer(memory::VERTEX, this->Pool.copyBuffer(), this->Pool.copyBufferSize());
+
+		this->Profiler.frame();
+		this->Benchmark.end();
+		this->Pacer.end();
 
 		return true;
 	}
 };
+}//namespace
 
-int main(int argc, char* argv[])
+static int run(int argc, char* argv[])
 {
 	int Error = 0;
 
@@ -227,4 +339,12 @@ int main(int argc, char* argv[])
 	return Error;
 }
 
-
+// 批量运行时不定义main 由batch-runner在同一个进程里依次运行
+#ifdef GLF_BATCH
+static bool const Registered = batch::add(SAMPLE_NAME, run);
+#else
+int main(int argc, char* argv[])
+{
+	return run(argc, argv);
+}
+#endif
@@ -1,15 +1,37 @@
 #include "test.hpp"
+#include "asset_pack.hpp"
+#include "batch.hpp"
+#include "benchmark.hpp"
+#include "frame_exporter.hpp"
+#include "frame_pacer.hpp"
+#include "material_atlas.hpp"
+#include "memory_tracker.hpp"
+#include "options.hpp"
+#include "resolution_scaler.hpp"
+#include "shader_loader.hpp"
+#include "startup_profiler.hpp"
+#include "std140.hpp"
+#include "texture_codec.hpp"
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
 
 namespace
 {
-	char const* VERT_SHADER_SOURCE_TEXTURE("gl-320/texture-2d.vert");
-	char const* FRAG_SHADER_SOURCE_TEXTURE("gl-320/texture-2d.frag");
+	char const* VERT_SHADER_SOURCE_TEXTURE("gl-320/texture-2d-array.vert");
+	char const* FRAG_SHADER_SOURCE_TEXTURE("gl-320/texture-2d-array.frag");
 	char const* VERT_SHADER_SOURCE_SPLASH("gl-320/fbo-depth-multisample.vert");
 	char const* FRAG_SHADER_SOURCE_SPLASH("gl-320/fbo-depth-multisample.frag");
+	char const* FRAG_SHADER_SOURCE_SPLASH_SCALED("gl-320/fbo-depth-multisample-scaled.frag");
+	char const* VERT_SHADER_SOURCE_PULL("gl-320/fbo-depth-multisample-pull.vert");
+	char const* VERT_SHADER_SOURCE_DEPTH("gl-320/fbo-depth-multisample-depth.vert");
+	char const* VERT_SHADER_SOURCE_PULL_DEPTH("gl-320/fbo-depth-multisample-pull-depth.vert");
 	char const* TEXTURE_DIFFUSE("kueken7_rgb_dxt1_unorm.dds");
 
+	char const* SAMPLE_NAME("gl-320-fbo-depth-multisample");
+	char const* ASSET_PACK("gl-320.pack");
+
 	GLsizei const VertexCount(4);
-	GLsizeiptr const VertexSize = VertexCount * sizeof(glf::vertex_v2fv2f);
 	glf::vertex_v2fv2f const VertexData[VertexCount] =
 	{
 		glf::vertex_v2fv2f(glm::vec2(-1.0f,-1.0f), glm::vec2(0.0f, 1.0f)),
@@ -19,13 +41,86 @@ namespace
 	};
 
 	GLsizei const ElementCount(6);
-	GLsizeiptr const ElementSize = ElementCount * sizeof(GLushort);
 	GLushort const ElementData[ElementCount] =
 	{
-		0, 1, 2, 
+		0, 1, 2,
 		2, 3, 0
 	};
 
+	// 深度pass投影的近平面和远平面 SPLASH线性化深度时使用同样的值
+	float const ProjectionNear(0.1f);
+	float const ProjectionFar(8.0f);
+
+	// Vertex format as read by the vertex pulling shader, in floats, -1 for a missing attribute
+	struct vertex_layout
+	{
+		GLint Stride;
+		GLint Position;
+		GLint Texcoord;
+	};
+
+	vertex_layout const VertexLayout = {GLint(sizeof(glf::vertex_v2fv2f) / sizeof(float)), 0, GLint(sizeof(glm::vec2) / sizeof(float))};
+
+	struct transform
+	{
+		static char const* name()
+		{
+			return "transform";
+		}
+
+		static std::vector<std140::member> members()
+		{
+			std140::member const Members[] =
+			{
+				std140::declare<glm::mat4>("transform.MVP", GLint(offsetof(transform, MVP)))
+			};
+			return std::vector<std140::member>(Members, Members + sizeof(Members) / sizeof(Members[0]));
+		}
+
+		glm::mat4 MVP;
+	};
+
+	static_assert(offsetof(transform, MVP) == std140::offset<glm::mat4>(0), "transform.MVP doesn't follow std140");
+	static_assert(sizeof(transform) == std140::end<glm::mat4>(0), "transform size doesn't follow std140");
+
+	// Must match MAX_INSTANCES in texture-2d-array.vert
+	GLsizei const MaxInstances(64);
+	GLsizei const InstanceCount(2);
+	// One atlas layer per material: the diffuse texture and a checker generated on the CPU
+	GLsizei const MaterialLayerCount(2);
+	// Squares per side of the checker material
+	std::size_t const CheckerTiles(8);
+
+	// 材质预览pass里实例之间的间距 模型空间 正方形宽2
+	float const PreviewSpacing(2.2f);
+
+	// Atlas layer of each instance, the layer is in x, and where the color pass draws the instance
+	// in model space, the depth pass doesn't read the block
+	struct material
+	{
+		static char const* name()
+		{
+			return "material";
+		}
+
+		static std::vector<std140::member> members()
+		{
+			std140::member const Members[] =
+			{
+				std140::declare<glm::ivec4>("material.Layer[0]", GLint(offsetof(material, Layer)), GLint(sizeof(glm::ivec4))),
+				std140::declare<glm::vec4>("material.Offset[0]", GLint(offsetof(material, Offset)), GLint(sizeof(glm::vec4)))
+			};
+			return std::vector<std140::member>(Members, Members + sizeof(Members) / sizeof(Members[0]));
+		}
+
+		glm::ivec4 Layer[MaxInstances];
+		glm::vec4 Offset[MaxInstances];
+	};
+
+	static_assert(offsetof(material, Layer) == std140::offset<glm::ivec4>(0), "material.Layer doesn't follow std140");
+	static_assert(offsetof(material, Offset) == std140::offset<glm::vec4>(std140::end<glm::ivec4>(0) * MaxInstances), "material.Offset doesn't follow std140");
+	static_assert(sizeof(material) == offsetof(material, Offset) + std140::end<glm::vec4>(0) * MaxInstances, "material size doesn't follow std140");
+
 	namespace buffer
 	{
 		enum type
@@ -33,6 +128,7 @@ namespace
 			VERTEX,
 			ELEMENT,
 			TRANSFORM,
+			MATERIAL,
 			MAX
 		};
 	}//namespace buffer
@@ -41,8 +137,10 @@ namespace
 	{
 		enum type
 		{
-			DIFFUSE,
-			MULTISAMPLE,
+			MULTISAMPLE,   // 4x 动态分辨率降低采样数时使用下面两个 顺序和TargetSamples一致
+			MULTISAMPLE_2X,
+			MULTISAMPLE_1X,
+			VERTEX,     // 顶点拉取用的缓冲区纹理 直接引用VBO
 			MAX
 		};
 	}//namespace texture
@@ -51,126 +149,273 @@ namespace
 	{
 		enum type
 		{
-			TEXTURE, // 用来算真实世界
+			TEXTURE, // 用来算真实世界 材质预览pass按实例从Atlas采样
 			SPLASH,  // 用于屏幕显示和后处理
+			DEPTH,   // TEXTURE的深度专用版本 没有片段着色器和材质块 只读取Position
+			PULL_TEXTURE, // TEXTURE的顶点拉取版本 顶点着色器用gl_VertexID自己从缓冲区纹理读取顶点
+			PULL_DEPTH,   // DEPTH的顶点拉取版本
 			MAX
 		};
 	}//namespace program
 
-	namespace framebuffer
+	// 每个工艺单的着色器 顺序和program::type一致 没有片段着色器的为空
+	// 开启动态分辨率时SPLASH换成FRAG_SHADER_SOURCE_SPLASH_SCALED
+	char const* const ProgramSources[program::MAX][2] =
+	{
+		{VERT_SHADER_SOURCE_TEXTURE, FRAG_SHADER_SOURCE_TEXTURE},
+		{VERT_SHADER_SOURCE_SPLASH, FRAG_SHADER_SOURCE_SPLASH},
+		{VERT_SHADER_SOURCE_DEPTH, nullptr},
+		{VERT_SHADER_SOURCE_PULL, FRAG_SHADER_SOURCE_TEXTURE},
+		{VERT_SHADER_SOURCE_PULL_DEPTH, nullptr}
+	};
+
+	// 顶点拉取的工艺单不需要顶点属性 不管顶点格式如何都共用同一个空VAO
+	namespace vertex_array
 	{
 		enum type
 		{
-			DEPTH_MULTISAMPLE,
+			TEXTURE,
+			SPLASH,
+			DEPTH,
+			PULL,
 			MAX
 		};
-	}//namespace framebuffer
+	}//namespace vertex_array
+
+	// 每个工艺单使用的VAO 顺序和program::type一致
+	vertex_array::type const ProgramVertexArray[program::MAX] =
+	{
+		vertex_array::TEXTURE,
+		vertex_array::SPLASH,
+		vertex_array::DEPTH,
+		vertex_array::PULL,
+		vertex_array::PULL
+	};
 
-	namespace shader
+	namespace framebuffer
 	{
 		enum type
 		{
-			VERT_TEXTURE,
-			FRAG_TEXTURE,
-			VERT_SPLASH,
-			FRAG_SPLASH,
+			DEPTH_MULTISAMPLE,
+			DEPTH_MULTISAMPLE_2X,
+			DEPTH_MULTISAMPLE_1X,
 			MAX
 		};
-	}//namespace shader
+	}//namespace framebuffer
 
 	std::vector<GLuint> FramebufferName(framebuffer::MAX);
+	std::vector<program::type> FramebufferProgram(framebuffer::MAX, program::TEXTURE);
 	std::vector<GLuint> ProgramName(program::MAX);
-	std::vector<GLuint> VertexArrayName(program::MAX);
+	std::vector<GLuint> VertexArrayName(vertex_array::MAX);
 	std::vector<GLuint> BufferName(buffer::MAX);
 	std::vector<GLuint> TextureName(texture::MAX);
-	GLint UniformTransform(0);
+	std::vector<GLint> UniformLayout(program::MAX, -1);
+	GLint UniformSplashScale(-1);
+	GLint UniformSplashSamples(-1);
+
+	// 每种采样数对应的纹理和帧缓冲区 相对MULTISAMPLE和DEPTH_MULTISAMPLE的偏移
+	GLsizei const TargetSamples[] = {4, 2, 1};
+
+	std::size_t target(GLsizei Samples)
+	{
+		for(std::size_t i = 0; i < sizeof(TargetSamples) / sizeof(TargetSamples[0]); ++i)
+			if(TargetSamples[i] == Samples)
+				return i;
+		return 0;
+	}
 }//namespace
 
+// 批量运行时多个样例链接进同一个进程 sample放在匿名命名空间里避免同名类冲突 不额外缩进
+namespace
+{
 class sample : public framework
 {
 public:
 	sample(int argc, char* argv[]) :
-		framework(argc, argv, "gl-320-fbo-depth-multisample", framework::CORE, 3, 2, glm::vec2(0.0f, -glm::pi<float>() * 0.48f))
+		framework(argc, argv, startup_profiler::start(SAMPLE_NAME), framework::CORE, 3, 2,
+			benchmark::windowSize(argc, argv), glm::vec2(0.0f, -glm::pi<float>() * 0.48f), glm::vec2(0.0f, 4.0f),
+			frame_exporter::frameCount(argc, argv, benchmark::frameCount(argc, argv))),
+		Pack(getDataDirectory() + ASSET_PACK),
+		Profiler(argc, argv),
+		Benchmark(argc, argv),
+		Pacer(argc, argv),
+		Memory(argc, argv, SAMPLE_NAME),
+		Scaler(argc, argv, TargetSamples[0]),
+		Exporter(argc, argv, glm::vec2(0.0f, -glm::pi<float>() * 0.48f), glm::vec2(0.0f, 4.0f)),
+		TransformStride(0),
+		VertexPulling(options::find(argc, argv, "--vertex-pulling") != nullptr),
+		MipFilterName(options::find(argc, argv, "--mip-filter")),
+		DiffuseLayer(-1),
+		CheckerLayer(-1)
 	{}
 
 private:
+	pack::reader Pack;
+	startup_profiler Profiler;
+	benchmark Benchmark;
+	frame_pacer Pacer;
+	memory_tracker Memory;
+	resolution_scaler Scaler;
+	frame_exporter Exporter;
+	GLintptr TransformStride;
+	bool VertexPulling;
+	// --mip-filter box|kaiser 转码时生成mipmap的滤波 默认kaiser
+	char const* MipFilterName;
+	material_atlas Atlas;
+	GLint DiffuseLayer;
+	GLint CheckerLayer;
+
 	bool initProgram()
 	{
 		bool Validated(true);
-	
-		std::vector<GLuint> ShaderName(shader::MAX);
+
 		compiler Compiler;
 
+		// 不开启动态分辨率时使用原来的SPLASH片段着色器 输出和原来的样例一致
+		char const* const SplashSource = this->Scaler.enabled() ? FRAG_SHADER_SOURCE_SPLASH_SCALED : FRAG_SHADER_SOURCE_SPLASH;
+		char const* const SplashSources[] = {VERT_SHADER_SOURCE_SPLASH, SplashSource};
+
+		// 批量运行时 之前链接过的工艺单直接从程序二进制恢复 跳过编译和链接
+		std::vector<std::string> ProgramKey(program::MAX);
+		std::vector<bool> Cached(program::MAX, false);
+		for(std::size_t i = 0; i < program::MAX; ++i)
+		{
+			ProgramName[i] = glCreateProgram();
+			ProgramKey[i] = batch::programKey(this->Pack, SAMPLE_NAME, i == program::SPLASH ? SplashSources : ProgramSources[i], 2);
+			Cached[i] = batch::loadProgram(ProgramName[i], ProgramKey[i]);
+		}
+
 		// 第一套ProgrameName工艺单用来画真实几何
-		if(Validated)
+		if(Validated && !Cached[program::TEXTURE])
 		{
-			// 获取顶点着色器
-			ShaderName[shader::VERT_TEXTURE] = Compiler.create(GL_VERTEX_SHADER, getDataDirectory() + VERT_SHADER_SOURCE_TEXTURE, "--version 150 --profile core");
-			// 获取片段着色器
-			ShaderName[shader::FRAG_TEXTURE] = Compiler.create(GL_FRAGMENT_SHADER, getDataDirectory() + FRAG_SHADER_SOURCE_TEXTURE, "--version 150 --profile core");
-
-			// 初始化纹理工艺流程单
-			ProgramName[program::TEXTURE] = glCreateProgram();
-			// 装配着色器
-			glAttachShader(ProgramName[program::TEXTURE], ShaderName[shader::VERT_TEXTURE]);
-			glAttachShader(ProgramName[program::TEXTURE], ShaderName[shader::FRAG_TEXTURE]);
-			
+			// 获取顶点着色器和片段着色器 优先从资源包中读取 并装配到工艺流程单
+			Validated = attachShader(this->Pack, Compiler, ProgramName[program::TEXTURE], GL_VERTEX_SHADER, VERT_SHADER_SOURCE_TEXTURE) && Validated;
+			Validated = attachShader(this->Pack, Compiler, ProgramName[program::TEXTURE], GL_FRAGMENT_SHADER, FRAG_SHADER_SOURCE_TEXTURE) && Validated;
+		
 			// 绑定shader中的顶点属性
 			glBindAttribLocation(ProgramName[program::TEXTURE], semantic::attr::POSITION, "Position");
 			// 绑定shader中的纹理属性
 			glBindAttribLocation(ProgramName[program::TEXTURE], semantic::attr::TEXCOORD, "Texcoord");
 			// 绑定片段着色器中的颜色输出
 			glBindFragDataLocation(ProgramName[program::TEXTURE], semantic::frag::COLOR, "Color");
-			
+		
 			//对第一个工艺流程单进行连接
 			glLinkProgram(ProgramName[program::TEXTURE]);
 		}
 
 
 		// 第二套工艺单用来将第一套的结果显示在屏幕上 和 后处理,与第一套的区别是不需要Poition 和 MVP
-		if(Validated)
+		if(Validated && !Cached[program::SPLASH])
 		{
-
-			// 绑定顶点着色器
-			ShaderName[shader::VERT_SPLASH] = Compiler.create(GL_VERTEX_SHADER, getDataDirectory() + VERT_SHADER_SOURCE_SPLASH, "--version 150 --profile core");
-			// 绑定片段着色器
-			ShaderName[shader::FRAG_SPLASH] = Compiler.create(GL_FRAGMENT_SHADER, getDataDirectory() + FRAG_SHADER_SOURCE_SPLASH, "--version 150 --profile core");
-			// 初始化工艺流程单
-			ProgramName[program::SPLASH] = glCreateProgram();
-			
-			// 装配着色器
-			glAttachShader(ProgramName[program::SPLASH], ShaderName[shader::VERT_SPLASH]);
-			glAttachShader(ProgramName[program::SPLASH], ShaderName[shader::FRAG_SPLASH]);
-			
+			// 绑定顶点着色器和片段着色器 并装配到工艺流程单
+			Validated = attachShader(this->Pack, Compiler, ProgramName[program::SPLASH], GL_VERTEX_SHADER, VERT_SHADER_SOURCE_SPLASH) && Validated;
+			Validated = attachShader(this->Pack, Compiler, ProgramName[program::SPLASH], GL_FRAGMENT_SHADER, SplashSource) && Validated;
+		
 			// 绑定片段着色器中的输出
 			glBindFragDataLocation(ProgramName[program::SPLASH], semantic::frag::COLOR, "Color");
-			
+		
 			// 对第二个工艺流程单进行连接
 			glLinkProgram(ProgramName[program::SPLASH]);
 		}
 
+		// 深度专用工艺单 只有一个只算位置的顶点着色器 没有颜色输出的帧缓冲区不需要执行片段着色器和纹理采样 也不需要材质
+		if(Validated && !Cached[program::DEPTH])
+		{
+			Validated = attachShader(this->Pack, Compiler, ProgramName[program::DEPTH], GL_VERTEX_SHADER, VERT_SHADER_SOURCE_DEPTH) && Validated;
+			glBindAttribLocation(ProgramName[program::DEPTH], semantic::attr::POSITION, "Position");
+			glLinkProgram(ProgramName[program::DEPTH]);
+		}
+
+		// 顶点拉取版本 不同的顶点格式共用同一个工艺单和同一个空VAO 格式由Layout描述
+		if(Validated && !Cached[program::PULL_TEXTURE])
+		{
+			Validated = attachShader(this->Pack, Compiler, ProgramName[program::PULL_TEXTURE], GL_VERTEX_SHADER, VERT_SHADER_SOURCE_PULL) && Validated;
+			Validated = attachShader(this->Pack, Compiler, ProgramName[program::PULL_TEXTURE], GL_FRAGMENT_SHADER, FRAG_SHADER_SOURCE_TEXTURE) && Validated;
+			glBindFragDataLocation(ProgramName[program::PULL_TEXTURE], semantic::frag::COLOR, "Color");
+			glLinkProgram(ProgramName[program::PULL_TEXTURE]);
+		}
+		if(Validated && !Cached[program::PULL_DEPTH])
+		{
+			Validated = attachShader(this->Pack, Compiler, ProgramName[program::PULL_DEPTH], GL_VERTEX_SHADER, VERT_SHADER_SOURCE_PULL_DEPTH) && Validated;
+			glLinkProgram(ProgramName[program::PULL_DEPTH]);
+		}
+
 		if(Validated)
 		{
 			Validated = Validated && Compiler.check();
 			Validated = Validated && Compiler.check_program(ProgramName[program::TEXTURE]);
 			Validated = Validated && Compiler.check_program(ProgramName[program::SPLASH]);
+			Validated = Validated && Compiler.check_program(ProgramName[program::DEPTH]);
+			Validated = Validated && Compiler.check_program(ProgramName[program::PULL_TEXTURE]);
+			Validated = Validated && Compiler.check_program(ProgramName[program::PULL_DEPTH]);
+		}
+		for(std::size_t i = 0; Validated && i < program::MAX; ++i)
+			if(!Cached[i])
+				batch::storeProgram(ProgramName[i], ProgramKey[i]);
+
+		// 链接后只检查一次std140布局并绑定插槽 之后每帧不再按名字查找
+		program::type const TransformProgram[] = {program::TEXTURE, program::DEPTH, program::PULL_TEXTURE, program::PULL_DEPTH};
+		for(std::size_t i = 0; Validated && i < sizeof(TransformProgram) / sizeof(TransformProgram[0]); ++i)
+		{
+			GLuint const Name = ProgramName[TransformProgram[i]];
+			Validated = std140::check<transform>(Name);
+			if(Validated)
+				glUniformBlockBinding(Name, glGetUniformBlockIndex(Name, transform::name()), semantic::uniform::TRANSFORM0);
+		}
+
+		// 只有带片段着色器的两个版本读取材质块 深度版本没有材质块 渲染时也不绑定MATERIAL
+		program::type const MaterialProgram[] = {program::TEXTURE, program::PULL_TEXTURE};
+		for(std::size_t i = 0; Validated && i < sizeof(MaterialProgram) / sizeof(MaterialProgram[0]); ++i)
+		{
+			GLuint const Name = ProgramName[MaterialProgram[i]];
+			Validated = std140::check<material>(Name);
+			if(Validated)
+				glUniformBlockBinding(Name, glGetUniformBlockIndex(Name, material::name()), semantic::uniform::MATERIAL);
 		}
 
+		// 顶点缓冲区纹理固定使用纹理单元1 纹理单元0留给材质纹理数组
+		program::type const PullProgram[] = {program::PULL_TEXTURE, program::PULL_DEPTH};
+		for(std::size_t i = 0; Validated && i < sizeof(PullProgram) / sizeof(PullProgram[0]); ++i)
+		{
+			GLuint const Name = ProgramName[PullProgram[i]];
+			UniformLayout[PullProgram[i]] = glGetUniformLocation(Name, "Layout");
+			glUseProgram(Name);
+			glUniform1i(glGetUniformLocation(Name, "Vertices"), 1);
+			// 深度版本只拉取位置 Layout.z为-1表示没有纹理坐标
+			GLint const Texcoord = PullProgram[i] == program::PULL_DEPTH ? -1 : VertexLayout.Texcoord;
+			glUniform4i(UniformLayout[PullProgram[i]], VertexLayout.Stride, VertexLayout.Position, Texcoord, 0);
+		}
+
+		// 动态分辨率时深度pass可能只画在渲染目标的一部分上 SPLASH按比例换算texelFetch的坐标
+		// 原来的SPLASH着色器没有这些uniform 位置为-1 设置时会被忽略
 		if(Validated)
-			UniformTransform = glGetUniformBlockIndex(ProgramName[program::TEXTURE], "transform");
+		{
+			GLuint const Name = ProgramName[program::SPLASH];
+			UniformSplashScale = glGetUniformLocation(Name, "Scale");
+			UniformSplashSamples = glGetUniformLocation(Name, "Samples");
+			glUseProgram(Name);
+			glUniform2f(glGetUniformLocation(Name, "Planes"), ProjectionNear, ProjectionFar);
+			glUniform1i(glGetUniformLocation(Name, "Diffuse"), 0);
+		}
+		glUseProgram(0);
 
 		return Validated && this->checkError("initProgram");
 	}
 
 	bool initBuffer()
 	{
+		GLsizeiptr const VertexSize = GLsizeiptr(VertexCount * sizeof(glf::vertex_v2fv2f));
+		GLsizeiptr const ElementSize = GLsizeiptr(ElementCount * sizeof(GLushort));
+
 		// 生成三个缓冲区 VAO VBO EBO
 		glGenBuffers(buffer::MAX, &BufferName[0]);
 		// 接下来指示的操作是说给EBO听的
 		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, BufferName[buffer::ELEMENT]);
-		
+	
 		// 将EBO的数据放到显存的合适位置 这块数据经常被cpu更改
 		glBufferData(GL_ELEMENT_ARRAY_BUFFER, ElementSize, ElementData, GL_STATIC_DRAW);
+		this->Memory.buffer(memory::INDEX, BufferName[buffer::ELEMENT], ElementSize);
+		this->Profiler.upload(ElementSize);
 
 		// 解绑
 		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
@@ -179,7 +424,9 @@ private:
 		// 接下来的操作是说给顶点缓冲区听的 VAO
 		glBindBuffer(GL_ARRAY_BUFFER, BufferName[buffer::VERTEX]);
 		// 将VAO的数据放在显存的合适位置 这块内存经常被cpu进行访问和修改
-		glBufferData(GL_ARRAY_BUFFER, VertexSize, VertexData, GL_STATIC_DRAW);
+		glBufferData(GL_ARRAY_BUFFER, VertexSize, &VertexData[0], GL_STATIC_DRAW);
+		this->Memory.buffer(memory::VERTEX, BufferName[buffer::VERTEX], VertexSize);
+		this->Profiler.upload(VertexSize);
 		// 解绑
 		glBindBuffer(GL_ARRAY_BUFFER, 0);
 
@@ -187,15 +434,23 @@ private:
 		GLint UniformBufferOffset(0);
 		// 系统目前提供的GPU最低的对齐字节
 		glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &UniformBufferOffset);
-		
+	
 		// UBO在GPU中的最低对齐字节至少为GPU要求的最低大小 但是如果你的mat4很大 我就以你为单位对齐
-		GLint UniformBlockSize = glm::max(GLint(sizeof(glm::mat4)), UniformBufferOffset);
+		this->TransformStride = std140::stride<transform>(UniformBufferOffset);
 
 		// 接下来的操作是说给UBO听的
 		glBindBuffer(GL_UNIFORM_BUFFER, BufferName[buffer::TRANSFORM]);
-		
-		// 给我至少一块能够存放MVP矩阵大小的GPU内存
-		glBufferData(GL_UNIFORM_BUFFER, UniformBlockSize, NULL, GL_DYNAMIC_DRAW);
+	
+		// 每个在途帧两块MVP矩阵大小的GPU内存 深度pass一块 材质预览一块 环形使用 CPU写的那一块GPU已经用完了
+		GLsizeiptr const TransformSize = this->TransformStride * 2 * GLintptr(this->Pacer.framesInFlight());
+		glBufferData(GL_UNIFORM_BUFFER, TransformSize, NULL, GL_DYNAMIC_DRAW);
+		this->Memory.buffer(memory::UNIFORM, BufferName[buffer::TRANSFORM], TransformSize);
+		glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+		// 每个实例使用材质纹理数组的哪一层和预览时的位置 在initTexture分配好层之后写入
+		glBindBuffer(GL_UNIFORM_BUFFER, BufferName[buffer::MATERIAL]);
+		glBufferData(GL_UNIFORM_BUFFER, std140::stride<material>(UniformBufferOffset), NULL, GL_STATIC_DRAW);
+		this->Memory.buffer(memory::UNIFORM, BufferName[buffer::MATERIAL], std140::stride<material>(UniformBufferOffset));
 		glBindBuffer(GL_UNIFORM_BUFFER, 0);
 
 		return this->checkError("initBuffer");
@@ -205,7 +460,7 @@ private:
 	bool initTexture()
 	{
 
-		// cpu ----> DIFFUSE 给几何体用
+		// cpu ----> 材质纹理数组 DIFFUSE是其中的一层 给几何体用
 		// cpu ----> MULTISAMPLE 深度专用
 
 
@@ -214,21 +469,25 @@ private:
 
 
 		bool Validated(true);                                                               
-		//读取一张dds纹理图片 加载到CPU
-		gli::texture2d Texture(gli::load_dds((getDataDirectory() + TEXTURE_DIFFUSE).c_str()));
+		//读取一张dds纹理图片 加载到CPU 资源包中有就直接从映射的内存解析 不再单独打开文件
+		gli::texture2d Texture;
+		void const* TextureData(nullptr);
+		std::size_t TextureSize(0);
+		std::vector<char> TextureBlob;
+		if(this->Pack.find(TEXTURE_DIFFUSE, TextureData, TextureSize))
+			Texture = gli::texture2d(gli::load_dds(static_cast<char const*>(TextureData), TextureSize));
+		else if(this->Pack.load(TEXTURE_DIFFUSE, TextureBlob))
+			Texture = gli::texture2d(gli::load_dds(TextureBlob.data(), TextureBlob.size()));
+		else
+			Texture = gli::texture2d(gli::load_dds((getDataDirectory() + TEXTURE_DIFFUSE).c_str()));
 		assert(!Texture.empty());
 
 		//告诉GPU接下来我要往GPU传输数据 每一行不要求四个字节对齐 这是为了压缩纹理安全
 		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
 
-		//GPU现在有两个纹理 	DIFFUSE	MULTISAMPLE
+		//GPU现在有两个纹理 	MULTISAMPLE VERTEX 材质纹理数组由Atlas管理
 		glGenTextures(texture::MAX, &TextureName[0]);
 
-		//我要在0号纹理槽 
-		glActiveTexture(GL_TEXTURE0);
-		//操作一个2D纹理对象 这个对象叫做 DIFFUSE
-		glBindTexture(GL_TEXTURE_2D, TextureName[texture::DIFFUSE]);
-
 
 		/***********************************************
 		* 这里扩展一个多重深度采样的原理 仅仅从理解上扩展 不讲数学原理
@@ -247,11 +506,27 @@ private:
 
 		/*告诉GPU 你的纹理可以在[0,N]层之间进行最优选择*/
 
-		// 告诉GPU接下来的纹理是从第0层 mipmap开始使用的
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+		// DDS缺少mipmap层级或者驱动不支持S3TC时 在CPU上解压并生成完整的mipmap链
+		std::size_t const TextureWidth = std::size_t(Texture[0].extent().x);
+		std::size_t const TextureHeight = std::size_t(Texture[0].extent().y);
+		std::size_t const LevelCount = mipmap::levels(TextureWidth, TextureHeight);
+		bool const S3TC = this->checkExtension("GL_EXT_texture_compression_s3tc");
+		bool const Compressed = Texture.format() == gli::FORMAT_RGB_DXT1_UNORM_BLOCK8;
+		bool const Transcode = !S3TC || !Compressed || Texture.levels() < LevelCount;
+
+		// 同样格式 同样大小的材质都放进一个2D纹理数组 每个材质占一层 绘制时不需要再切换纹理
+		// mipmap的层级范围[0,N]由Atlas设置
+		GLsizei const AtlasLevels = GLsizei(Transcode ? LevelCount : Texture.levels());
+		GLenum const AtlasFormat = S3TC ? GL_COMPRESSED_RGB_S3TC_DXT1_EXT : GL_RGBA8;
+		this->Atlas.init(AtlasFormat, GLsizei(TextureWidth), GLsizei(TextureHeight), AtlasLevels, MaterialLayerCount);
+		if(!this->checkError("initTexture.Atlas"))
+			return false;
+		this->Memory.texture(memory::TEXTURE, this->Atlas.name(), AtlasFormat, GLsizei(TextureWidth), GLsizei(TextureHeight), MaterialLayerCount, AtlasLevels, 1);
+		DiffuseLayer = this->Atlas.allocate();
+		CheckerLayer = this->Atlas.allocate();
 
-		// 告诉GPU接下来你最多可以用到哪一层的mipmap
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, GLint(Texture.levels() - 1));
+		//我要在0号纹理槽 操作这个纹理数组
+		this->Atlas.bind(0);
 
 
 
@@ -260,89 +535,233 @@ private:
 		// 当纹理需要被缩小时该使用什么取样规则
 		// 例如纹理是1024*1024 但是屏幕上只画100*100 纹理需要缩小
 		// 不使用插值 选一层mipmap 再直接取一个最近的元素
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
-		
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+	
 		// 当纹理需要被放大时使用什么规则
 		// 例如纹理是256*256 屏幕上画1024*1024 --->一个纹理对应一大块像素 方块感强 像素边缘清晰 类似于
 		// 我的世界
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-		
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
 	
+
 		/*越界处理规则 纹理的坐标映射是[0,1]*/
 
 		// 横向越界 超出0-1的部分 直接贴着边缘取颜色 ---> 不重复 不镜像 不黑边
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-		
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	
 		// 横向越界 超出0-1的部分 直接贴着边缘取颜色 ----> 不重复 不镜像 不黑边
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-		
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	
 
 
 		  // 向GPU上传纹理压缩数据 为什么要使用纹理压缩 ？
 		 //  1减少显存占用 
 		//   2对于压缩的纹理GPU传输处理数据更快
-		for(std::size_t Level = 0; Level < Texture.levels(); ++Level)
+		for(std::size_t Level = 0; !Transcode && Level < Texture.levels(); ++Level)
 		{
 
 		   /*
-			*GL_TEXTURE_2D,                      指定上传的数据是一张纹理
+			*DiffuseLayer,                       写入纹理数组中的哪一层
 			*GLint(Level),                       纹理的层级[0,N] <--->[最大分辨率，最小分辨率]
-			*GL_COMPRESSED_RGB_S3TC_DXT1_EXT,    指定纹理的压缩格式 DXT1
-			*GLsizei(Texture[Level].extent().x), 当前mipmap的宽度
-			*GLsizei(Texture[Level].extent().y), 当前mipmap的高度
-			*0,                                  不适用额外的边界
-			*GLsizei(Texture[Level].size()),     当前mipmap层级图像的大小
-			*Texture[Level].data())              当前miapmap层级图像的数据 
-			*/           
-			glCompressedTexImage2D(GL_TEXTURE_2D,
-				GLint(Level),
-				GL_COMPRESSED_RGB_S3TC_DXT1_EXT,
-				GLsizei(Texture[Level].extent().x),
-				GLsizei(Texture[Level].extent().y),
-				0, 
-				GLsizei(Texture[Level].size()),
-				Texture[Level].data());
+			*Texture[Level].data(),              当前miapmap层级图像的数据 格式是Atlas的DXT1
+			*GLsizei(Texture[Level].size())      当前mipmap层级图像的大小 宽高由Atlas按层级算出
+			*/
+			this->Atlas.upload(DiffuseLayer, GLint(Level), Texture[Level].data(), GLsizei(Texture[Level].size()));
+			this->Profiler.upload(Texture[Level].size());
 		}
-		
+
+		// 新生成的mipmap层级用哪种滤波 默认Kaiser 比Box更锐利 转码只在加载时做一次
+		mipmap::filter MipFilter(mipmap::FILTER_KAISER);
+		if(this->MipFilterName && std::strcmp(this->MipFilterName, "box") == 0)
+			MipFilter = mipmap::FILTER_BOX;
+		else if(this->MipFilterName && std::strcmp(this->MipFilterName, "kaiser") != 0)
+		{
+			std::fprintf(stderr, "Unknown --mip-filter \"%s\", expected box or kaiser\n", this->MipFilterName);
+			return false;
+		}
+
+		if(Transcode)
+		{
+			// 转码结果按纹理 目标格式和滤波缓存在进程里 批量运行时后面的样例跳过解压和压缩直接上传
+			std::string const ChainKey = std::string(TEXTURE_DIFFUSE) + (S3TC ? ":dxt1" : ":rgba8") + (MipFilter == mipmap::FILTER_KAISER ? ":kaiser" : ":box");
+			std::vector<unsigned char>& Chain = batch::blob(ChainKey);
+			if(Chain.empty())
+			{
+				std::vector<unsigned char> Image(TextureWidth * TextureHeight * 4);
+				std::vector<unsigned char> NextImage(Image.size());
+				std::vector<unsigned char> Blocks(bc1::size(TextureWidth, TextureHeight));
+				// 转码只接受DXT1 RGBA8和RGB8 其他格式直接报错 不能按RGBA8去读
+				unsigned char const* Source = static_cast<unsigned char const*>(Texture[0].data());
+				if(Compressed)
+					bc1::decode(Source, TextureWidth, TextureHeight, &Image[0]);
+				else if(Texture.format() == gli::FORMAT_RGBA8_UNORM_PACK8 && Texture[0].size() >= Image.size())
+					std::memcpy(&Image[0], Source, Image.size());
+				else if(Texture.format() == gli::FORMAT_RGB8_UNORM_PACK8 && Texture[0].size() >= TextureWidth * TextureHeight * 3)
+				{
+					for(std::size_t i = 0; i < TextureWidth * TextureHeight; ++i)
+					{
+						std::memcpy(&Image[i * 4], Source + i * 3, 3);
+						Image[i * 4 + 3] = 255;
+					}
+				}
+				else
+				{
+					std::fprintf(stderr, "%s: unsupported texture format for transcoding\n", TEXTURE_DIFFUSE);
+					return false;
+				}
+
+				std::size_t Width = TextureWidth;
+				std::size_t Height = TextureHeight;
+				for(std::size_t Level = 0; Level < LevelCount; ++Level)
+				{
+					// DDS里已有的DXT1层级直接使用原来的块 只压缩新生成的层级 避免解压再压缩损失画质
+					std::size_t const LevelSize = bc1::size(Width, Height);
+					bool const Original = S3TC && Compressed && Level < Texture.levels() && Texture[Level].size() >= LevelSize;
+					if(Original)
+					{
+						unsigned char const* LevelData = static_cast<unsigned char const*>(Texture[Level].data());
+						Chain.insert(Chain.end(), LevelData, LevelData + LevelSize);
+					}
+					// 支持S3TC时压缩成DXT1 否则直接使用未压缩的RGBA8
+					else if(S3TC)
+					{
+						bc1::encode(&Image[0], Width, Height, &Blocks[0]);
+						Chain.insert(Chain.end(), Blocks.begin(), Blocks.begin() + LevelSize);
+					}
+					else
+						Chain.insert(Chain.end(), Image.begin(), Image.begin() + Width * Height * 4);
+
+					if(Level + 1 < LevelCount)
+					{
+						mipmap::downsample(&Image[0], Width, Height, &NextImage[0], MipFilter);
+						Image.swap(NextImage);
+						Width = std::max<std::size_t>(1, Width / 2);
+						Height = std::max<std::size_t>(1, Height / 2);
+					}
+				}
+			}
+
+			std::size_t Offset(0);
+			std::size_t Width = TextureWidth;
+			std::size_t Height = TextureHeight;
+			for(std::size_t Level = 0; Level < LevelCount; ++Level)
+			{
+				std::size_t const Size = S3TC ? bc1::size(Width, Height) : Width * Height * 4;
+				if(S3TC)
+					this->Atlas.upload(DiffuseLayer, GLint(Level), &Chain[Offset], GLsizei(Size));
+				else
+					this->Atlas.upload(DiffuseLayer, GLint(Level), GL_RGBA, GL_UNSIGNED_BYTE, &Chain[Offset]);
+				this->Profiler.upload(Size);
+
+				Offset += Size;
+				Width = std::max<std::size_t>(1, Width / 2);
+				Height = std::max<std::size_t>(1, Height / 2);
+			}
+		}
+	
+		// 第二个材质是CPU生成的棋盘格 和DIFFUSE同样大小同样的mipmap层数 放进Atlas的另一层
+		{
+			std::vector<unsigned char> Image(TextureWidth * TextureHeight * 4);
+			std::vector<unsigned char> NextImage(Image.size());
+			std::vector<unsigned char> Blocks(bc1::size(TextureWidth, TextureHeight));
+			unsigned char const Light[] = {255, 160, 0, 255};
+			unsigned char const Dark[] = {32, 32, 32, 255};
+			for(std::size_t y = 0; y < TextureHeight; ++y)
+				for(std::size_t x = 0; x < TextureWidth; ++x)
+				{
+					bool const Odd = ((x * CheckerTiles / TextureWidth) + (y * CheckerTiles / TextureHeight)) % 2 != 0;
+					std::memcpy(&Image[(y * TextureWidth + x) * 4], Odd ? Light : Dark, 4);
+				}
+
+			std::size_t Width = TextureWidth;
+			std::size_t Height = TextureHeight;
+			for(GLsizei Level = 0; Level < AtlasLevels; ++Level)
+			{
+				if(S3TC)
+				{
+					std::size_t const Size = bc1::size(Width, Height);
+					bc1::encode(&Image[0], Width, Height, &Blocks[0]);
+					this->Atlas.upload(CheckerLayer, Level, &Blocks[0], GLsizei(Size));
+					this->Profiler.upload(Size);
+				}
+				else
+				{
+					this->Atlas.upload(CheckerLayer, Level, GL_RGBA, GL_UNSIGNED_BYTE, &Image[0]);
+					this->Profiler.upload(Width * Height * 4);
+				}
+
+				if(Level + 1 < AtlasLevels)
+				{
+					mipmap::downsample(&Image[0], Width, Height, &NextImage[0], MipFilter);
+					Image.swap(NextImage);
+					Width = std::max<std::size_t>(1, Width / 2);
+					Height = std::max<std::size_t>(1, Height / 2);
+				}
+			}
+		}
+
+		// 实例交替使用DIFFUSE和棋盘格两层 在预览里从左到右排开 一次实例化绘制画出不同材质的实例
+		{
+			material Material;
+			for(GLsizei i = 0; i < MaxInstances; ++i)
+			{
+				Material.Layer[i] = glm::ivec4(i < InstanceCount ? (i % 2 == 0 ? DiffuseLayer : CheckerLayer) : 0);
+				Material.Offset[i] = glm::vec4((float(i) - float(InstanceCount - 1) * 0.5f) * PreviewSpacing, 0.0f, 0.0f, 0.0f);
+			}
+			bool const Uploaded = std140::upload(BufferName[buffer::MATERIAL], 0, Material);
+			glBindBuffer(GL_UNIFORM_BUFFER, 0);
+			if(!Uploaded)
+				return false;
+		}
+
 		// 获取当前的窗口尺寸
 		glm::ivec2 WindowSize(this->getWindowSize());
 
 		// 告诉GPU激活纹理单元0
 		glActiveTexture(GL_TEXTURE0);
 
-		// 通知GPU绑定多重深度采样纹理单元
-		glBindTexture(GL_TEXTURE_2D_MULTISAMPLE, TextureName[texture::MULTISAMPLE]);
-		
-		this->checkError("initTexture 1");
-		
-		// 使用的mipmap层级都是0级
-		glTexParameteri(GL_TEXTURE_2D_MULTISAMPLE, GL_TEXTURE_BASE_LEVEL, 0);
-		glTexParameteri(GL_TEXTURE_2D_MULTISAMPLE, GL_TEXTURE_MAX_LEVEL, 0);
-		
-		this->checkError("initTexture 2");
-		
-		// 创建一个2D多重采样纹理 它有四个探测器 
-		// 对于当前纹理存储的是深度信息 而不是 颜色信息 
-		// 指定纹理的尺寸
-		// GL_TRUE 告诉GPU纹理中的每一个像素都包含四个样本数据进行采样 是一个完整的多重采样纹理
-		glTexImage2DMultisample(GL_TEXTURE_2D_MULTISAMPLE, 4, GL_DEPTH_COMPONENT24, GLsizei(WindowSize.x), GLsizei(WindowSize.y), GL_TRUE);
-		
+		// 动态分辨率只缩小视口 渲染目标一次按窗口大小分配好 切换时不需要重新分配
+		// 允许降低采样数时 每种采样数各分配一个
+		std::vector<GLsizei> const Samples = this->Scaler.samples();
+		for(std::size_t i = 0; i < Samples.size(); ++i)
+		{
+			GLuint const Name = TextureName[texture::MULTISAMPLE + target(Samples[i])];
+
+			// 通知GPU绑定多重深度采样纹理单元
+			glBindTexture(GL_TEXTURE_2D_MULTISAMPLE, Name);
+
+			// 使用的mipmap层级都是0级
+			glTexParameteri(GL_TEXTURE_2D_MULTISAMPLE, GL_TEXTURE_BASE_LEVEL, 0);
+			glTexParameteri(GL_TEXTURE_2D_MULTISAMPLE, GL_TEXTURE_MAX_LEVEL, 0);
+
+			// 创建一个2D多重采样纹理 默认有四个探测器
+			// 对于当前纹理存储的是深度信息 而不是 颜色信息
+			// 指定纹理的尺寸
+			// GL_TRUE 告诉GPU纹理中的每一个像素都包含所有样本数据进行采样 是一个完整的多重采样纹理
+			glTexImage2DMultisample(GL_TEXTURE_2D_MULTISAMPLE, Samples[i], GL_DEPTH_COMPONENT24, GLsizei(WindowSize.x), GLsizei(WindowSize.y), GL_TRUE);
+			this->Memory.texture(memory::RENDER_TARGET, Name, GL_DEPTH_COMPONENT24, GLsizei(WindowSize.x), GLsizei(WindowSize.y), 1, 1, Samples[i]);
+		}
+
 		// 确保纹理数据是4字节对齐的 加快GPU的解算速度
 		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
 
+		// 顶点拉取: 把VBO当作每个texel一个float的缓冲区纹理 不复制数据
+		glBindTexture(GL_TEXTURE_BUFFER, TextureName[texture::VERTEX]);
+		glTexBuffer(GL_TEXTURE_BUFFER, GL_R32F, BufferName[buffer::VERTEX]);
+		glBindTexture(GL_TEXTURE_BUFFER, 0);
+
 		return Validated && this->checkError("initTexture");
 	}
 
 	bool initVertexArray()
 	{
 		// 在GPU生成VAO标志
-		glGenVertexArrays(program::MAX, &VertexArrayName[0]);
+		glGenVertexArrays(vertex_array::MAX, &VertexArrayName[0]);
 		// 接下在的操作是说给TEXTTURE这个VAO说的 接下来的顶点读取规则都会被记录进当前这个VAO
-		glBindVertexArray(VertexArrayName[program::TEXTURE]);
-		
+		glBindVertexArray(VertexArrayName[vertex_array::TEXTURE]);
+	
 		//接下来的顶点描述来自这个VBO，VAO你要记住我的规则
 		glBindBuffer(GL_ARRAY_BUFFER, BufferName[buffer::VERTEX]);
-		
+	
 		// 对于Poition顶点 它在vertex_v2fv2f 这个 struct中 从偏移量0开始读2个
 		glVertexAttribPointer(semantic::attr::POSITION, 2, GL_FLOAT, GL_FALSE, sizeof(glf::vertex_v2fv2f), BUFFER_OFFSET(0));
 		// 对于Textcoord顶点 它在vertex_v2fv2f 这个 struct中 从偏移量vec2的大小初开始读 都两个
@@ -350,29 +769,66 @@ private:
 		//  VAO已经记住读取的规则了 VBO你可以空闲了 我对你解绑了
 		glBindBuffer(GL_ARRAY_BUFFER, 0);
 
-		
-		
+	
+	
 		// 打开顶点着色器中的顶点position属性 让VAO可以进行从当前GL_ARRAY_BUFFER按照规则往着色器中写入
 		glEnableVertexAttribArray(semantic::attr::POSITION);
-		
+	
 		// 打开顶点着色器中的顶点textcoord属性 让VAO可以进行从当前GL_ARRAY_BUFFER按照规则往着色器中写入
 		glEnableVertexAttribArray(semantic::attr::TEXCOORD);
 
 
 		// 让VAO记住使用哪个索引缓冲区
 		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, BufferName[buffer::ELEMENT]);
-		
+	
 		// 至此 VAO所有的规则已经全部学会 处于空闲状态
 		glBindVertexArray(0);
 
 
+		// 深度专用的VAO 只读取Position 不读取和位置无关的Texcoord
+		glBindVertexArray(VertexArrayName[vertex_array::DEPTH]);
+		glBindBuffer(GL_ARRAY_BUFFER, BufferName[buffer::VERTEX]);
+		glVertexAttribPointer(semantic::attr::POSITION, 2, GL_FLOAT, GL_FALSE, sizeof(glf::vertex_v2fv2f), BUFFER_OFFSET(0));
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		glEnableVertexAttribArray(semantic::attr::POSITION);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, BufferName[buffer::ELEMENT]);
+		glBindVertexArray(0);
+
+		// 两个顶点拉取工艺单共用的VAO 没有任何顶点属性 只记住索引缓冲区
+		glBindVertexArray(VertexArrayName[vertex_array::PULL]);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, BufferName[buffer::ELEMENT]);
+		glBindVertexArray(0);
+
 		// 在任何绘制之前 OpenGL core file 要求绑定一个VAO ，即使你没有用
-		glBindVertexArray(VertexArrayName[program::SPLASH]);
+		glBindVertexArray(VertexArrayName[vertex_array::SPLASH]);
 		glBindVertexArray(0);
 
 		return this->checkError("initVertexArray");
 	}
 
+	// 根据当前绑定的帧缓冲区选择工艺单: 没有任何颜色输出时使用深度专用版本
+	// 这个样例的深度pass总是深度专用版本 带材质的版本只在材质预览pass里使用
+	program::type selectProgram() const
+	{
+		GLint MaxDrawBuffers(0);
+		glGetIntegerv(GL_MAX_DRAW_BUFFERS, &MaxDrawBuffers);
+
+		for(GLint i = 0; i < MaxDrawBuffers; ++i)
+		{
+			GLint DrawBuffer(GL_NONE);
+			glGetIntegerv(GL_DRAW_BUFFER0 + i, &DrawBuffer);
+			if(DrawBuffer == GL_NONE)
+				continue;
+
+			GLint Type(GL_NONE);
+			glGetFramebufferAttachmentParameteriv(GL_DRAW_FRAMEBUFFER, GLenum(DrawBuffer), GL_FRAMEBUFFER_ATTACHMENT_OBJECT_TYPE, &Type);
+			if(Type != GL_NONE)
+				return program::TEXTURE;
+		}
+
+		return program::DEPTH;
+	}
+
 	bool initFramebuffer()
 	{
 		bool Validated(true);
@@ -383,16 +839,24 @@ private:
 		// 创建一个帧缓冲区编号 
 		glGenFramebuffers(GLsizei(framebuffer::MAX), &FramebufferName[0]);
 
-		// 绑定一个帧缓冲区 以后所有的绘制操作都会在当前帧缓冲区上进行
-		glBindFramebuffer(GL_FRAMEBUFFER, FramebufferName[framebuffer::DEPTH_MULTISAMPLE]);
+		std::vector<GLsizei> const Samples = this->Scaler.samples();
+		for(std::size_t i = 0; i < Samples.size(); ++i)
+		{
+			std::size_t const Target = target(Samples[i]);
 
-		// 告诉GPU将后面的 TextureName[texture::MULTISAMPLE] 纹理 作为神附件 附加到帧缓冲上 ，附加的是纹理的第一个层级
-		glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, TextureName[texture::MULTISAMPLE], 0);
+			// 绑定一个帧缓冲区 以后所有的绘制操作都会在当前帧缓冲区上进行
+			glBindFramebuffer(GL_FRAMEBUFFER, FramebufferName[framebuffer::DEPTH_MULTISAMPLE + Target]);
 
-		glDrawBuffer(GL_NONE);
+			// 告诉GPU将后面的 TextureName[texture::MULTISAMPLE] 纹理 作为神附件 附加到帧缓冲上 ，附加的是纹理的第一个层级
+			glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, TextureName[texture::MULTISAMPLE + Target], 0);
 
-		if(!this->checkFramebuffer(FramebufferName[framebuffer::DEPTH_MULTISAMPLE]))
-			return false;
+			glDrawBuffer(GL_NONE);
+
+			if(!this->checkFramebuffer(FramebufferName[framebuffer::DEPTH_MULTISAMPLE + Target]))
+				return false;
+
+			FramebufferProgram[framebuffer::DEPTH_MULTISAMPLE + Target] = selectProgram();
+		}
 
 		glBindFramebuffer(GL_FRAMEBUFFER, 0);	
 		return this->checkError("initFramebuffer");
@@ -402,91 +866,199 @@ private:
 	{
 		bool Validated(true);
 
-		
+		// 扩展只由框架检查一次 结果交给各个计时和统计工具
+		bool const TimerQuery = this->checkExtension("GL_ARB_timer_query");
+		this->Profiler.setTimerQuery(TimerQuery);
+		this->Benchmark.setTimerQuery(TimerQuery);
+		this->Pacer.setTimerQuery(TimerQuery);
+		batch::setProgramBinary(this->checkExtension("GL_ARB_get_program_binary"));
+		this->Scaler.setTimerQuery(TimerQuery);
+		if(this->Memory.enabled())
+			this->Memory.setDriverQuery(
+				this->checkExtension("GL_NVX_gpu_memory_info") ? memory::DRIVER_NVX :
+				this->checkExtension("GL_ATI_meminfo") ? memory::DRIVER_ATI : memory::DRIVER_NONE);
 
 		if(Validated)
+		{
+			startup_profiler::phase Phase(this->Profiler, "initProgram");
 			Validated = initProgram();
+		}
 		if(Validated)
+		{
+			startup_profiler::phase Phase(this->Profiler, "initBuffer");
 			Validated = initBuffer();
+		}
 		if(Validated)
+		{
+			startup_profiler::phase Phase(this->Profiler, "initVertexArray");
 			Validated = initVertexArray();
+		}
 		if(Validated)
+		{
+			startup_profiler::phase Phase(this->Profiler, "initTexture");
 			Validated = initTexture();
+		}
 		if(Validated)
+		{
+			startup_profiler::phase Phase(this->Profiler, "initFramebuffer");
 			Validated = initFramebuffer();
+		}
 
 		return Validated && this->checkError("begin");
 	}
 
 	bool end()
 	{
+		// 在删除对象之前检查 删除一个还绑定着的对象会自动解绑 之后就看不出样例留下了什么状态
+		bool Validated = batch::resetState(SAMPLE_NAME);
+
+		// 删除对象时同时从显存统计中去掉 报告里的峰值是运行时的占用 剩下的live是没有释放的
+		this->Memory.release(memory::BUFFER, buffer::MAX, &BufferName[0]);
+		this->Memory.release(memory::TEXTURE_OBJECT, texture::MAX, &TextureName[0]);
+		GLuint const AtlasName = this->Atlas.name();
+		this->Memory.release(memory::TEXTURE_OBJECT, 1, &AtlasName);
+
 		glDeleteFramebuffers(GLsizei(FramebufferName.size()), &FramebufferName[0]);
 		glDeleteProgram(ProgramName[program::SPLASH]);
 		glDeleteProgram(ProgramName[program::TEXTURE]);
+		glDeleteProgram(ProgramName[program::DEPTH]);
+		glDeleteProgram(ProgramName[program::PULL_TEXTURE]);
+		glDeleteProgram(ProgramName[program::PULL_DEPTH]);
 		glDeleteBuffers(buffer::MAX, &BufferName[0]);
 		glDeleteTextures(texture::MAX, &TextureName[0]);
-		glDeleteVertexArrays(program::MAX, &VertexArrayName[0]);
+		this->Atlas.release();
+		this->Scaler.release();
+		glDeleteVertexArrays(vertex_array::MAX, &VertexArrayName[0]);
+
+		Validated = this->Profiler.save(SAMPLE_NAME) && Validated;
+		Validated = this->Benchmark.save(SAMPLE_NAME) && Validated;
+		Validated = this->Pacer.save(SAMPLE_NAME) && Validated;
+		Validated = this->Exporter.save() && Validated;
+		Validated = this->Memory.save() && Validated;
 
-		return this->checkError("end");
+		return Validated && this->checkError("end");
 	}
 
 	bool render()
 	{
+		this->Pacer.begin();
+		this->Benchmark.begin();
+
 		glm::ivec2 WindowSize(this->getWindowSize());
+		GLintptr const TransformOffset = this->TransformStride * 2 * GLintptr(this->Pacer.slot());
+		GLintptr const PreviewTransformOffset = TransformOffset + this->TransformStride;
 
-		{
-			glBindBuffer(GL_UNIFORM_BUFFER, BufferName[buffer::TRANSFORM]);
-			glm::mat4* Pointer = (glm::mat4*)glMapBufferRange(
-				GL_UNIFORM_BUFFER, 0,	sizeof(glm::mat4),
-				GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+		// 动态分辨率 根据前几帧深度pass的GPU耗时选择这一帧的渲染大小和采样数
+		// 导出序列时固定分辨率 输出只取决于帧序号
+		if(!this->Exporter.enabled())
+			this->Scaler.update();
+		resolution_scaler::level const& Resolution = this->Scaler.current();
+		glm::ivec2 const RenderSize = this->Scaler.size(WindowSize);
+		std::size_t const Target = target(Resolution.Samples);
 
+		{
 			//glm::mat4 Projection = glm::perspectiveFov(glm::pi<float>() * 0.25f, 640.f, 480.f, 0.1f, 100.0f);
-			glm::mat4 Projection = glm::perspective(glm::pi<float>() * 0.25f, 4.0f / 3.0f, 0.1f, 8.0f);
+			glm::mat4 Projection = glm::perspective(glm::pi<float>() * 0.25f, 4.0f / 3.0f, ProjectionNear, ProjectionFar);
 			glm::mat4 Model = glm::scale(glm::mat4(1.0f), glm::vec3(5.0f));
-		
-			*Pointer = Projection * this->view() * Model;
+
+			transform Transform;
+			Transform.MVP = Projection * (this->Exporter.enabled() ? this->Exporter.view() : this->view()) * Model;
 
 			// Make sure the uniform buffer is uploaded
-			glUnmapBuffer(GL_UNIFORM_BUFFER);
+			if(!std140::upload(BufferName[buffer::TRANSFORM], TransformOffset, Transform, GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT))
+				return false;
+
+			// 材质预览正对着看 所有实例按Material.Offset排成一行 刚好填满预览视口
+			float const HalfWidth = float(InstanceCount) * PreviewSpacing * 0.5f;
+			transform Preview;
+			Preview.MVP = glm::ortho(-HalfWidth, HalfWidth, -PreviewSpacing * 0.5f, PreviewSpacing * 0.5f, -1.0f, 1.0f);
+			if(!std140::upload(BufferName[buffer::TRANSFORM], PreviewTransformOffset, Preview, GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT))
+				return false;
 		}
 
 		glEnable(GL_DEPTH_TEST);
 		glDepthFunc(GL_LESS);
 
-		glViewport(0, 0, WindowSize.x, WindowSize.y);
+		glViewport(0, 0, RenderSize.x, RenderSize.y);
 
-		glBindFramebuffer(GL_FRAMEBUFFER, FramebufferName[framebuffer::DEPTH_MULTISAMPLE]);
+		glBindFramebuffer(GL_FRAMEBUFFER, FramebufferName[framebuffer::DEPTH_MULTISAMPLE + Target]);
+		this->Scaler.begin();
 		float Depth(1.0f);
 		glClearBufferfv(GL_DEPTH , 0, &Depth);
 
 		// Bind rendering objects
-		glUseProgram(ProgramName[program::TEXTURE]);
-		glUniformBlockBinding(ProgramName[program::TEXTURE], UniformTransform, semantic::uniform::TRANSFORM0);
+		program::type Program = FramebufferProgram[framebuffer::DEPTH_MULTISAMPLE + Target];
+		if(this->VertexPulling)
+		{
+			Program = Program == program::DEPTH ? program::PULL_DEPTH : program::PULL_TEXTURE;
+			glActiveTexture(GL_TEXTURE1);
+			glBindTexture(GL_TEXTURE_BUFFER, TextureName[texture::VERTEX]);
+		}
+		glUseProgram(ProgramName[Program]);
 
-		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_2D, TextureName[texture::DIFFUSE]);
-		glBindVertexArray(VertexArrayName[program::TEXTURE]);
-		glBindBufferBase(GL_UNIFORM_BUFFER, semantic::uniform::TRANSFORM0, BufferName[buffer::TRANSFORM]);
+		// 所有材质都在同一个纹理数组里 整个pass只绑定一次
+		if(Program == program::TEXTURE || Program == program::PULL_TEXTURE)
+		{
+			this->Atlas.bind(0);
+			glBindBufferBase(GL_UNIFORM_BUFFER, semantic::uniform::MATERIAL, BufferName[buffer::MATERIAL]);
+		}
+		glBindVertexArray(VertexArrayName[ProgramVertexArray[Program]]);
+		glBindBufferRange(GL_UNIFORM_BUFFER, semantic::uniform::TRANSFORM0, BufferName[buffer::TRANSFORM], TransformOffset, sizeof(transform));
 
-		glDrawElementsInstancedBaseVertex(GL_TRIANGLES, ElementCount, GL_UNSIGNED_SHORT, 0, 2, 0);
+		glDrawElementsInstancedBaseVertex(GL_TRIANGLES, ElementCount, GL_UNSIGNED_SHORT, 0, InstanceCount, 0);
+		this->Scaler.end();
+		this->Exporter.captureDepth(FramebufferName[framebuffer::DEPTH_MULTISAMPLE + Target], RenderSize);
 
 		// Pass 2
 		glDisable(GL_DEPTH_TEST);
 
 		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		glViewport(0, 0, WindowSize.x, WindowSize.y);
 		glUseProgram(ProgramName[program::SPLASH]);
+		glUniform2f(UniformSplashScale, float(RenderSize.x) / float(WindowSize.x), float(RenderSize.y) / float(WindowSize.y));
+		glUniform1i(UniformSplashSamples, Resolution.Samples);
 
 		glActiveTexture(GL_TEXTURE0);
-		glBindVertexArray(VertexArrayName[program::SPLASH]);
-		glBindTexture(GL_TEXTURE_2D_MULTISAMPLE, TextureName[texture::MULTISAMPLE]);
+		glBindVertexArray(VertexArrayName[vertex_array::SPLASH]);
+		glBindTexture(GL_TEXTURE_2D_MULTISAMPLE, TextureName[texture::MULTISAMPLE + Target]);
 
 		glDrawArraysInstanced(GL_TRIANGLES, 0, 3, 1);
 
+		// Pass 3 材质预览 在屏幕右下角用带片段着色器的工艺单画出所有实例
+		// 每个实例按Material.Layer从Atlas的不同层采样 不同材质也只需要一次实例化绘制
+		{
+			GLsizei const PreviewHeight = WindowSize.y / 4;
+			GLsizei const PreviewWidth = PreviewHeight * InstanceCount;
+			glViewport(WindowSize.x - PreviewWidth, 0, PreviewWidth, PreviewHeight);
+
+			program::type const PreviewProgram = this->VertexPulling ? program::PULL_TEXTURE : program::TEXTURE;
+			if(this->VertexPulling)
+			{
+				glActiveTexture(GL_TEXTURE1);
+				glBindTexture(GL_TEXTURE_BUFFER, TextureName[texture::VERTEX]);
+			}
+			glUseProgram(ProgramName[PreviewProgram]);
+			this->Atlas.bind(0);
+			glBindBufferBase(GL_UNIFORM_BUFFER, semantic::uniform::MATERIAL, BufferName[buffer::MATERIAL]);
+			glBindBufferRange(GL_UNIFORM_BUFFER, semantic::uniform::TRANSFORM0, BufferName[buffer::TRANSFORM], PreviewTransformOffset, sizeof(transform));
+			glBindVertexArray(VertexArrayName[ProgramVertexArray[PreviewProgram]]);
+
+			glDrawElementsInstancedBaseVertex(GL_TRIANGLES, ElementCount, GL_UNSIGNED_SHORT, 0, InstanceCount, 0);
+		}
+
+		this->Exporter.capture(WindowSize);
+		this->Exporter.end();
+
+		this->Profiler.frame();
+		this->Benchmark.end();
+		this->Pacer.end();
+
 		return true;
 	}
 };
+}//namespace
 
-int main(int argc, char* argv[])
+static int run(int argc, char* argv[])
 {
 	int Error = 0;
 
@@ -496,3 +1068,12 @@ int main(int argc, char* argv[])
 	return Error;
 }
 
+// 批量运行时不定义main 由batch-runner在同一个进程里依次运行
+#ifdef GLF_BATCH
+static bool const Registered = batch::add(SAMPLE_NAME, run);
+#else
+int main(int argc, char* argv[])
+{
+	return run(argc, argv);
+}
+#endif
@@ -0,0 +1,69 @@
+#include "mesh_lod.hpp"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+// Usage: mesh-lod-benchmark [grid size] [levels] [pixel error]
+// Builds the LOD chain of a tessellated height field and reports, for a range of camera
+// distances, the level selected and the triangles saved against always drawing level 0
+int main(int argc, char* argv[])
+{
+	std::size_t const Size = argc > 1 ? std::size_t(std::atoi(argv[1])) : 128;
+	std::size_t const LevelCount = argc > 2 ? std::size_t(std::atoi(argv[2])) : 10;
+	float const PixelError = argc > 3 ? float(std::atof(argv[3])) : 1.0f;
+	float const ViewportHeight = 480.0f;
+
+	// (Size + 1)^2 vertices addressed with GLushort indices
+	if(Size == 0 || (Size + 1) * (Size + 1) > lod::MAX_VERTICES)
+	{
+		std::fprintf(stderr, "grid size must be between 1 and 254\n");
+		return 1;
+	}
+
+	// Unit square with low frequency bumps, flat areas collapse early, bumps later
+	std::vector<glm::vec3> Positions;
+	Positions.reserve((Size + 1) * (Size + 1));
+	for(std::size_t y = 0; y <= Size; ++y)
+		for(std::size_t x = 0; x <= Size; ++x)
+		{
+			float const u = float(x) / float(Size) * 2.0f - 1.0f;
+			float const v = float(y) / float(Size) * 2.0f - 1.0f;
+			float const h = 0.15f * std::sin(u * 9.0f) * std::cos(v * 7.0f);
+			Positions.push_back(glm::vec3(u, v, h));
+		}
+
+	std::vector<GLushort> Indices;
+	Indices.reserve(Size * Size * 6);
+	for(std::size_t y = 0; y < Size; ++y)
+		for(std::size_t x = 0; x < Size; ++x)
+		{
+			GLushort const i = GLushort(y * (Size + 1) + x);
+			GLushort const Quad[] = {i, GLushort(i + 1), GLushort(i + Size + 2), GLushort(i + Size + 2), GLushort(i + Size + 1), i};
+			Indices.insert(Indices.end(), Quad, Quad + 6);
+		}
+
+	std::chrono::steady_clock::time_point const Start = std::chrono::steady_clock::now();
+	lod::chain const Chain = lod::build(Positions, &Indices[0], Indices.size(), LevelCount);
+	double const Seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - Start).count();
+
+	std::printf("%u vertices, %u triangles, built in %.1f ms\n", unsigned(Positions.size()), unsigned(Indices.size() / 3), Seconds * 1000.0);
+	for(std::size_t Level = 0; Level < Chain.Levels.size(); ++Level)
+		std::printf("  lod %u: %7u triangles, error %.5f\n", unsigned(Level), unsigned(Chain.Levels[Level].Count / 3), Chain.Levels[Level].Error);
+
+	glm::mat4 const Projection = glm::perspective(glm::pi<float>() * 0.25f, 4.0f / 3.0f, 0.1f, 1000.0f);
+	float const Full = float(Chain.Levels[0].Count / 3);
+
+	std::printf("distance  lod  triangles  saved\n");
+	for(float Distance = 2.0f; Distance <= 256.0f; Distance *= 2.0f)
+	{
+		glm::mat4 const MVP = glm::translate(Projection, glm::vec3(0.0f, 0.0f, -Distance));
+		std::size_t const Level = lod::select(Chain, MVP, ViewportHeight, PixelError);
+		float const Triangles = float(Chain.Levels[Level].Count / 3);
+		std::printf("%8.0f  %3u  %9u  %4.1f%%\n", Distance, unsigned(Level), unsigned(Triangles), (1.0f - Triangles / Full) * 100.0f);
+	}
+
+	return 0;
+}
@@ -0,0 +1,125 @@
+#include "texture_codec.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <thread>
+#include <vector>
+
+// Usage: texture-codec-benchmark [size] [iterations]
+// Throughput in MPixel/s of the BC1 codec and the mip generator against the scalar reference
+namespace
+{
+	double measure(std::size_t Pixels, int Iterations, std::function<void()> const& Function)
+	{
+		Function();
+
+		std::chrono::steady_clock::time_point const Start = std::chrono::steady_clock::now();
+		for(int i = 0; i < Iterations; ++i)
+			Function();
+		double const Seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - Start).count();
+
+		return double(Pixels) * Iterations / Seconds * 1e-6;
+	}
+}//namespace
+
+int main(int argc, char* argv[])
+{
+	std::size_t const Size = argc > 1 ? std::size_t(std::atoi(argv[1])) : 2048;
+	int const Iterations = argc > 2 ? std::atoi(argv[2]) : 8;
+	std::size_t const Pixels = Size * Size;
+	std::size_t const Threads = std::thread::hardware_concurrency();
+
+	// Smooth gradients with some noise, closer to real art than pure noise
+	std::vector<unsigned char> Image(Pixels * 4);
+	std::srand(1);
+	for(std::size_t y = 0; y < Size; ++y)
+		for(std::size_t x = 0; x < Size; ++x)
+		{
+			unsigned char* Texel = &Image[(y * Size + x) * 4];
+			Texel[0] = static_cast<unsigned char>((x * 255 / Size + std::rand() % 16) & 0xFF);
+			Texel[1] = static_cast<unsigned char>((y * 255 / Size + std::rand() % 16) & 0xFF);
+			Texel[2] = static_cast<unsigned char>(((x + y) * 127 / Size) & 0xFF);
+			Texel[3] = 255;
+		}
+
+	std::vector<unsigned char> Blocks(bc1::size(Size, Size));
+	std::vector<unsigned char> Scalar(Pixels * 4);
+	std::vector<unsigned char> Decoded(Pixels * 4);
+	std::vector<unsigned char> Mip(Pixels);
+
+	std::printf("%ux%u, %u threads\n", unsigned(Size), unsigned(Size), unsigned(Threads));
+
+	std::printf("bc1 encode, 1 thread:        %8.1f MPixel/s\n", measure(Pixels, Iterations, [&]() { bc1::encode(&Image[0], Size, Size, &Blocks[0], 1); }));
+	std::printf("bc1 encode, all threads:     %8.1f MPixel/s\n", measure(Pixels, Iterations, [&]() { bc1::encode(&Image[0], Size, Size, &Blocks[0]); }));
+	std::printf("bc1 decode, scalar:          %8.1f MPixel/s\n", measure(Pixels, Iterations, [&]() { bc1::decodeScalar(&Blocks[0], Size, Size, &Scalar[0]); }));
+	std::printf("bc1 decode, 1 thread:        %8.1f MPixel/s\n", measure(Pixels, Iterations, [&]() { bc1::decode(&Blocks[0], Size, Size, &Decoded[0], 1); }));
+	std::printf("bc1 decode, all threads:     %8.1f MPixel/s\n", measure(Pixels, Iterations, [&]() { bc1::decode(&Blocks[0], Size, Size, &Decoded[0]); }));
+	std::printf("mip box, 1 thread:           %8.1f MPixel/s\n", measure(Pixels, Iterations, [&]() { mipmap::downsample(&Image[0], Size, Size, &Mip[0], mipmap::FILTER_BOX, 1); }));
+	std::printf("mip box, all threads:        %8.1f MPixel/s\n", measure(Pixels, Iterations, [&]() { mipmap::downsample(&Image[0], Size, Size, &Mip[0], mipmap::FILTER_BOX); }));
+	std::printf("mip kaiser, 1 thread:        %8.1f MPixel/s\n", measure(Pixels, Iterations, [&]() { mipmap::downsample(&Image[0], Size, Size, &Mip[0], mipmap::FILTER_KAISER, 1); }));
+	std::printf("mip kaiser, all threads:     %8.1f MPixel/s\n", measure(Pixels, Iterations, [&]() { mipmap::downsample(&Image[0], Size, Size, &Mip[0], mipmap::FILTER_KAISER); }));
+
+	// The fast decoder has to match the reference bit for bit
+	if(std::memcmp(&Scalar[0], &Decoded[0], Scalar.size()) != 0)
+	{
+		std::fprintf(stderr, "bc1::decode doesn't match bc1::decodeScalar\n");
+		return 1;
+	}
+
+	// Both filters keep a flat color flat, weights add up to one and the sRGB round trip is exact.
+	// On a smooth ramp the Kaiser filter stays close to the box filter, ringing shows up as a
+	// large difference
+	{
+		std::size_t const CheckSize = 64;
+		std::vector<unsigned char> Flat(CheckSize * CheckSize * 4);
+		std::vector<unsigned char> Ramp(CheckSize * CheckSize * 4);
+		for(std::size_t i = 0; i < CheckSize * CheckSize; ++i)
+		{
+			unsigned char const Texel[] = {200, 90, 30, 255};
+			std::memcpy(&Flat[i * 4], Texel, 4);
+			std::size_t const x = i % CheckSize;
+			Ramp[i * 4 + 0] = Ramp[i * 4 + 1] = Ramp[i * 4 + 2] = static_cast<unsigned char>(x * 255 / (CheckSize - 1));
+			Ramp[i * 4 + 3] = 255;
+		}
+
+		std::vector<unsigned char> Box(CheckSize * CheckSize);
+		std::vector<unsigned char> Kaiser(CheckSize * CheckSize);
+		int FlatError(0), RampError(0);
+		for(int f = 0; f < 2; ++f)
+		{
+			mipmap::downsample(&Flat[0], CheckSize, CheckSize, &Box[0], f == 0 ? mipmap::FILTER_BOX : mipmap::FILTER_KAISER);
+			for(std::size_t i = 0; i < CheckSize * CheckSize; ++i)
+				FlatError = std::max(FlatError, std::abs(int(Box[i]) - int(Flat[i % 4])));
+		}
+
+		mipmap::downsample(&Ramp[0], CheckSize, CheckSize, &Box[0], mipmap::FILTER_BOX);
+		mipmap::downsample(&Ramp[0], CheckSize, CheckSize, &Kaiser[0], mipmap::FILTER_KAISER);
+		for(std::size_t y = 0; y < CheckSize / 2; ++y)
+			for(std::size_t x = 2; x + 2 < CheckSize / 2; ++x)
+				for(std::size_t c = 0; c < 4; ++c)
+				{
+					std::size_t const i = (y * CheckSize / 2 + x) * 4 + c;
+					RampError = std::max(RampError, std::abs(int(Box[i]) - int(Kaiser[i])));
+				}
+
+		std::printf("mip flat color max error:    %8d\n", FlatError);
+		std::printf("mip kaiser vs box on a ramp: %8d\n", RampError);
+		if(FlatError > 1 || RampError > 4)
+		{
+			std::fprintf(stderr, "mipmap::downsample doesn't preserve flat colors or rings on a ramp\n");
+			return 1;
+		}
+	}
+
+	double Error = 0.0;
+	for(std::size_t i = 0; i < Pixels * 4; ++i)
+		Error += double(int(Image[i]) - int(Decoded[i])) * double(int(Image[i]) - int(Decoded[i]));
+	std::printf("bc1 round trip RMSE:         %8.2f\n", std::sqrt(Error / double(Pixels * 4)));
+
+	return 0;
+}
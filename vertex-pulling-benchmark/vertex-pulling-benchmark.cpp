@@ -0,0 +1,344 @@
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#define GL_GLEXT_PROTOTYPES
+#include <GL/glcorearb.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+// Usage: vertex-pulling-benchmark [data directory] [grid size] [instances] [frames]
+// Vertex fetch throughput of fbo-depth-multisample's shaders, fixed function attributes against
+// vertex pulling from a buffer texture, in million vertices per second. A dense grid in the sample's
+// vertex format is drawn instanced into a small 4x multisample target, once with every triangle
+// culled after the vertex shader and once rasterized.
+// Creates a GL 3.2 core context through EGL surfaceless, e.g. Mesa llvmpipe without a display:
+// EGL_PLATFORM=surfaceless LIBGL_ALWAYS_SOFTWARE=1 vertex-pulling-benchmark data/
+namespace
+{
+	// Same layout as glf::vertex_v2fv2f, which the sample draws
+	struct vertex
+	{
+		float Position[2];
+		float Texcoord[2];
+	};
+
+	GLuint const POSITION(0);
+	GLuint const TEXCOORD(4);
+	GLuint const MATERIAL(0);
+	GLuint const TRANSFORM0(1);
+	GLsizei const TARGET_SIZE(64);
+
+	bool load(std::string const& Filename, std::string& Source)
+	{
+		FILE* File = std::fopen(Filename.c_str(), "rb");
+		if(!File)
+			return false;
+
+		char Buffer[4096];
+		for(std::size_t Read = 0; (Read = std::fread(Buffer, 1, sizeof(Buffer), File)) > 0;)
+			Source.append(Buffer, Read);
+		return std::fclose(File) == 0;
+	}
+
+	GLuint compile(std::string const& Directory, GLenum Type, char const* Name)
+	{
+		std::string Source;
+		if(!load(Directory + Name, Source))
+		{
+			std::fprintf(stderr, "Can't read %s%s\n", Directory.c_str(), Name);
+			return 0;
+		}
+
+		GLchar const* String = Source.c_str();
+		GLuint const ShaderName = glCreateShader(Type);
+		glShaderSource(ShaderName, 1, &String, NULL);
+		glCompileShader(ShaderName);
+
+		GLint Status(GL_FALSE);
+		glGetShaderiv(ShaderName, GL_COMPILE_STATUS, &Status);
+		if(Status != GL_TRUE)
+		{
+			char Log[4096];
+			glGetShaderInfoLog(ShaderName, sizeof(Log), NULL, Log);
+			std::fprintf(stderr, "%s:\n%s\n", Name, Log);
+			glDeleteShader(ShaderName);
+			return 0;
+		}
+		return ShaderName;
+	}
+
+	// Bindings match what fbo-depth-multisample sets up after link
+	GLuint link(std::string const& Directory, char const* Vert, char const* Frag)
+	{
+		GLuint const ProgramName = glCreateProgram();
+		GLuint const VertName = compile(Directory, GL_VERTEX_SHADER, Vert);
+		GLuint const FragName = Frag ? compile(Directory, GL_FRAGMENT_SHADER, Frag) : 0;
+		if(!VertName || (Frag && !FragName))
+			return 0;
+
+		glAttachShader(ProgramName, VertName);
+		if(FragName)
+			glAttachShader(ProgramName, FragName);
+		glBindAttribLocation(ProgramName, POSITION, "Position");
+		glBindAttribLocation(ProgramName, TEXCOORD, "Texcoord");
+		if(FragName)
+			glBindFragDataLocation(ProgramName, 0, "Color");
+		glLinkProgram(ProgramName);
+		glDeleteShader(VertName);
+		if(FragName)
+			glDeleteShader(FragName);
+
+		GLint Status(GL_FALSE);
+		glGetProgramiv(ProgramName, GL_LINK_STATUS, &Status);
+		if(Status != GL_TRUE)
+		{
+			char Log[4096];
+			glGetProgramInfoLog(ProgramName, sizeof(Log), NULL, Log);
+			std::fprintf(stderr, "%s:\n%s\n", Vert, Log);
+			return 0;
+		}
+
+		GLuint const TransformIndex = glGetUniformBlockIndex(ProgramName, "transform");
+		if(TransformIndex != GL_INVALID_INDEX)
+			glUniformBlockBinding(ProgramName, TransformIndex, TRANSFORM0);
+		GLuint const MaterialIndex = glGetUniformBlockIndex(ProgramName, "material");
+		if(MaterialIndex != GL_INVALID_INDEX)
+			glUniformBlockBinding(ProgramName, MaterialIndex, MATERIAL);
+
+		// Vertices on unit 1, unit 0 is the material atlas, Layout.z = -1 when texcoords aren't read
+		glUseProgram(ProgramName);
+		glUniform1i(glGetUniformLocation(ProgramName, "Vertices"), 1);
+		glUniform1i(glGetUniformLocation(ProgramName, "Diffuse"), 0);
+		GLint const Stride = GLint(sizeof(vertex) / sizeof(float));
+		glUniform4i(glGetUniformLocation(ProgramName, "Layout"), Stride, 0, Frag ? 2 : -1, 0);
+		glUseProgram(0);
+
+		return ProgramName;
+	}
+
+	struct variant
+	{
+		char const* Name;
+		char const* Vert;
+		char const* Frag;
+		bool Pulling;
+	};
+}//namespace
+
+int main(int argc, char* argv[])
+{
+	std::string Directory = argc > 1 ? argv[1] : "data/";
+	if(!Directory.empty() && Directory[Directory.size() - 1] != '/')
+		Directory += '/';
+	std::size_t const Size = argc > 2 ? std::size_t(std::atoi(argv[2])) : 128;
+	GLsizei const Instances = argc > 3 ? GLsizei(std::atoi(argv[3])) : 16;
+	int const Frames = argc > 4 ? std::atoi(argv[4]) : 10;
+
+	// (Size + 1)^2 vertices addressed with GLushort indices, at most MAX_INSTANCES in the shaders
+	if(Size == 0 || (Size + 1) * (Size + 1) > 65535 || Instances <= 0 || Instances > 64 || Frames <= 0)
+	{
+		std::fprintf(stderr, "grid size must be between 1 and 254, instances between 1 and 64\n");
+		return 1;
+	}
+
+	PFNEGLGETPLATFORMDISPLAYEXTPROC GetPlatformDisplay = reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(eglGetProcAddress("eglGetPlatformDisplayEXT"));
+	EGLDisplay Display = GetPlatformDisplay ? GetPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL) : EGL_NO_DISPLAY;
+	EGLint Major(0), Minor(0);
+	if(Display == EGL_NO_DISPLAY || !eglInitialize(Display, &Major, &Minor) || !eglBindAPI(EGL_OPENGL_API))
+	{
+		std::fprintf(stderr, "EGL surfaceless isn't available\n");
+		return 1;
+	}
+
+	EGLint const ContextAttributes[] =
+	{
+		EGL_CONTEXT_MAJOR_VERSION, 3,
+		EGL_CONTEXT_MINOR_VERSION, 2,
+		EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+		EGL_NONE
+	};
+	EGLContext Context = eglCreateContext(Display, EGL_NO_CONFIG_KHR, EGL_NO_CONTEXT, ContextAttributes);
+	if(Context == EGL_NO_CONTEXT || !eglMakeCurrent(Display, EGL_NO_SURFACE, EGL_NO_SURFACE, Context))
+	{
+		std::fprintf(stderr, "Can't create a GL 3.2 core context\n");
+		return 1;
+	}
+
+	// Grid over the whole target, texcoords follow the position
+	std::vector<vertex> Vertices;
+	for(std::size_t y = 0; y <= Size; ++y)
+		for(std::size_t x = 0; x <= Size; ++x)
+		{
+			float const u = float(x) / float(Size);
+			float const v = float(y) / float(Size);
+			vertex const Vertex = {{u * 2.0f - 1.0f, v * 2.0f - 1.0f}, {u, v}};
+			Vertices.push_back(Vertex);
+		}
+
+	std::vector<GLushort> Indices;
+	for(std::size_t y = 0; y < Size; ++y)
+		for(std::size_t x = 0; x < Size; ++x)
+		{
+			GLushort const i = GLushort(y * (Size + 1) + x);
+			GLushort const Quad[] = {i, GLushort(i + 1), GLushort(i + Size + 2), GLushort(i + Size + 2), GLushort(i + Size + 1), i};
+			Indices.insert(Indices.end(), Quad, Quad + 6);
+		}
+
+	enum {VERTEX, ELEMENT, TRANSFORM, MATERIAL_BUFFER, BUFFER_MAX};
+	GLuint BufferName[BUFFER_MAX];
+	glGenBuffers(BUFFER_MAX, BufferName);
+	glBindBuffer(GL_ARRAY_BUFFER, BufferName[VERTEX]);
+	glBufferData(GL_ARRAY_BUFFER, GLsizeiptr(Vertices.size() * sizeof(vertex)), &Vertices[0], GL_STATIC_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	// Identity MVP, every layer 0: the material block is zeroed, whatever else it holds
+	float const Identity[16] = {1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1};
+	std::vector<char> const Zero(64 * 1024, 0);
+	glBindBuffer(GL_UNIFORM_BUFFER, BufferName[TRANSFORM]);
+	glBufferData(GL_UNIFORM_BUFFER, sizeof(Identity), Identity, GL_STATIC_DRAW);
+	glBindBuffer(GL_UNIFORM_BUFFER, BufferName[MATERIAL_BUFFER]);
+	glBufferData(GL_UNIFORM_BUFFER, GLsizeiptr(Zero.size()), &Zero[0], GL_STATIC_DRAW);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	glBindBufferBase(GL_UNIFORM_BUFFER, TRANSFORM0, BufferName[TRANSFORM]);
+	glBindBufferBase(GL_UNIFORM_BUFFER, MATERIAL, BufferName[MATERIAL_BUFFER]);
+
+	// Attribute VAO as initVertexArray builds it, and the empty VAO shared by the pulling programs
+	enum {ATTRIBUTES, PULL, VERTEX_ARRAY_MAX};
+	GLuint VertexArrayName[VERTEX_ARRAY_MAX];
+	glGenVertexArrays(VERTEX_ARRAY_MAX, VertexArrayName);
+	glBindVertexArray(VertexArrayName[ATTRIBUTES]);
+	glBindBuffer(GL_ARRAY_BUFFER, BufferName[VERTEX]);
+	glVertexAttribPointer(POSITION, 2, GL_FLOAT, GL_FALSE, sizeof(vertex), reinterpret_cast<void const*>(0));
+	glVertexAttribPointer(TEXCOORD, 2, GL_FLOAT, GL_FALSE, sizeof(vertex), reinterpret_cast<void const*>(sizeof(float) * 2));
+	glEnableVertexAttribArray(POSITION);
+	glEnableVertexAttribArray(TEXCOORD);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, BufferName[ELEMENT]);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, GLsizeiptr(Indices.size() * sizeof(GLushort)), &Indices[0], GL_STATIC_DRAW);
+	glBindVertexArray(VertexArrayName[PULL]);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, BufferName[ELEMENT]);
+	glBindVertexArray(0);
+
+	// Unit 0: a one texel atlas, unit 1: the vertex buffer seen as floats
+	enum {ATLAS, VERTEX_TEXTURE, COLOR, DEPTH, TEXTURE_MAX};
+	GLuint TextureName[TEXTURE_MAX];
+	glGenTextures(TEXTURE_MAX, TextureName);
+	unsigned char const White[4] = {255, 255, 255, 255};
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, TextureName[ATLAS]);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, 0);
+	glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8, 1, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, White);
+	glActiveTexture(GL_TEXTURE1);
+	glBindTexture(GL_TEXTURE_BUFFER, TextureName[VERTEX_TEXTURE]);
+	glTexBuffer(GL_TEXTURE_BUFFER, GL_R32F, BufferName[VERTEX]);
+	glActiveTexture(GL_TEXTURE0);
+
+	// Depth only target like the sample's 4x depth pass, color is added for the textured variants
+	glBindTexture(GL_TEXTURE_2D_MULTISAMPLE, TextureName[DEPTH]);
+	glTexImage2DMultisample(GL_TEXTURE_2D_MULTISAMPLE, 4, GL_DEPTH_COMPONENT24, TARGET_SIZE, TARGET_SIZE, GL_TRUE);
+	glBindTexture(GL_TEXTURE_2D_MULTISAMPLE, TextureName[COLOR]);
+	glTexImage2DMultisample(GL_TEXTURE_2D_MULTISAMPLE, 4, GL_RGBA8, TARGET_SIZE, TARGET_SIZE, GL_TRUE);
+	glBindTexture(GL_TEXTURE_2D_MULTISAMPLE, 0);
+
+	enum {FRAMEBUFFER_DEPTH, FRAMEBUFFER_COLOR, FRAMEBUFFER_MAX};
+	GLuint FramebufferName[FRAMEBUFFER_MAX];
+	glGenFramebuffers(FRAMEBUFFER_MAX, FramebufferName);
+	glBindFramebuffer(GL_FRAMEBUFFER, FramebufferName[FRAMEBUFFER_DEPTH]);
+	glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, TextureName[DEPTH], 0);
+	glDrawBuffer(GL_NONE);
+	glBindFramebuffer(GL_FRAMEBUFFER, FramebufferName[FRAMEBUFFER_COLOR]);
+	glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, TextureName[DEPTH], 0);
+	glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, TextureName[COLOR], 0);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	variant const Variants[] =
+	{
+		{"depth, attributes", "gl-320/fbo-depth-multisample-depth.vert", NULL, false},
+		{"depth, pulling", "gl-320/fbo-depth-multisample-pull-depth.vert", NULL, true},
+		{"texture, attributes", "gl-320/texture-2d-array.vert", "gl-320/texture-2d-array.frag", false},
+		{"texture, pulling", "gl-320/fbo-depth-multisample-pull.vert", "gl-320/texture-2d-array.frag", true}
+	};
+
+	GLsizei const IndexCount = GLsizei(Indices.size());
+	double const VerticesPerFrame = double(IndexCount) * double(Instances);
+
+	std::printf("%s, %u vertices, %u triangles x %d instances, %d frames\n",
+		reinterpret_cast<char const*>(glGetString(GL_RENDERER)), unsigned(Vertices.size()), unsigned(IndexCount / 3), int(Instances), Frames);
+
+	glViewport(0, 0, TARGET_SIZE, TARGET_SIZE);
+	glEnable(GL_DEPTH_TEST);
+	glDepthFunc(GL_LESS);
+	glCullFace(GL_FRONT_AND_BACK);
+
+	std::printf("Mvertices/s            vertex only   rasterized\n");
+
+	int Error(0);
+	for(std::size_t i = 0; i < sizeof(Variants) / sizeof(Variants[0]); ++i)
+	{
+		variant const& Variant = Variants[i];
+		GLuint const ProgramName = link(Directory, Variant.Vert, Variant.Frag);
+		if(!ProgramName)
+		{
+			Error = 1;
+			continue;
+		}
+
+		glBindFramebuffer(GL_FRAMEBUFFER, FramebufferName[Variant.Frag ? FRAMEBUFFER_COLOR : FRAMEBUFFER_DEPTH]);
+		glUseProgram(ProgramName);
+		glBindVertexArray(VertexArrayName[Variant.Pulling ? PULL : ATTRIBUTES]);
+
+		// Culling every triangle after the vertex shader leaves the vertex work only, the second run
+		// rasterizes the triangles too. One warm up frame each, then the median frame, the CPU
+		// rasterizer shares the machine with whatever else runs
+		double Seconds[2] = {0.0, 0.0};
+		for(int Pass = 0; Pass < 2; ++Pass)
+		{
+			if(Pass == 0)
+				glEnable(GL_CULL_FACE);
+			else
+				glDisable(GL_CULL_FACE);
+
+			std::vector<double> Times;
+			for(int Frame = -1; Frame < Frames; ++Frame)
+			{
+				std::chrono::steady_clock::time_point const Start = std::chrono::steady_clock::now();
+				float const Depth(1.0f);
+				glClearBufferfv(GL_DEPTH, 0, &Depth);
+				glDrawElementsInstancedBaseVertex(GL_TRIANGLES, IndexCount, GL_UNSIGNED_SHORT, 0, Instances, 0);
+				glFinish();
+				if(Frame >= 0)
+					Times.push_back(std::chrono::duration<double>(std::chrono::steady_clock::now() - Start).count());
+			}
+			std::nth_element(Times.begin(), Times.begin() + Times.size() / 2, Times.end());
+			Seconds[Pass] = Times[Times.size() / 2];
+		}
+
+		std::printf("%-22s %12.1f %12.1f\n", Variant.Name, VerticesPerFrame / Seconds[0] * 1e-6, VerticesPerFrame / Seconds[1] * 1e-6);
+		glDeleteProgram(ProgramName);
+	}
+
+	if(glGetError() != GL_NO_ERROR)
+	{
+		std::fprintf(stderr, "GL error\n");
+		Error = 1;
+	}
+
+	glBindVertexArray(0);
+	glUseProgram(0);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glDeleteFramebuffers(FRAMEBUFFER_MAX, FramebufferName);
+	glDeleteTextures(TEXTURE_MAX, TextureName);
+	glDeleteVertexArrays(VERTEX_ARRAY_MAX, VertexArrayName);
+	glDeleteBuffers(BUFFER_MAX, BufferName);
+
+	eglMakeCurrent(Display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+	eglDestroyContext(Display, Context);
+	eglTerminate(Display);
+
+	return Error;
+}